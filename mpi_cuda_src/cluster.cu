@@ -88,7 +88,8 @@ __global__ void updateCentroids(
     }
 }
 
-void run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_points, int k, int maxEpochs, int D) {
+int run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_points, int k, int maxEpochs, int D,
+                   double* sums, long long* counts) {
     float *d_coords, *d_centroids, *d_sums, *d_minDistances;
     int *d_assignments, *d_counts, *d_changed;
 
@@ -105,7 +106,9 @@ void run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_p
 
     cudaMemcpy(d_coords, coords, coord_size, cudaMemcpyHostToDevice);
     cudaMemcpy(d_centroids, centroids, centroid_size, cudaMemcpyHostToDevice);
-    cudaMemset(d_assignments, -1, num_points * sizeof(int));
+    cudaMemcpy(d_assignments, assignments, num_points * sizeof(int), cudaMemcpyHostToDevice);
+    cudaMemset(d_sums, 0, centroid_size);
+    cudaMemset(d_counts, 0, k * sizeof(int));
 
     int h_changed = 1;
     int threads = BLOCK_SIZE;
@@ -138,6 +141,20 @@ void run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_p
     cudaMemcpy(assignments, d_assignments, num_points * sizeof(int), cudaMemcpyDeviceToHost);
     cudaMemcpy(centroids, d_centroids, centroid_size, cudaMemcpyDeviceToHost);
 
+    // sums and counts of the last epoch, i.e. of the final assignments
+    float* h_sums = (float*)malloc(centroid_size);
+    int* h_counts = (int*)malloc(k * sizeof(int));
+    cudaMemcpy(h_sums, d_sums, centroid_size, cudaMemcpyDeviceToHost);
+    cudaMemcpy(h_counts, d_counts, k * sizeof(int), cudaMemcpyDeviceToHost);
+    for (int i = 0; i < k * D; i++) {
+        sums[i] = h_sums[i];
+    }
+    for (int i = 0; i < k; i++) {
+        counts[i] = h_counts[i];
+    }
+    free(h_sums);
+    free(h_counts);
+
     cudaFree(d_coords);
     cudaFree(d_centroids);
     cudaFree(d_assignments);
@@ -145,4 +162,6 @@ void run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_p
     cudaFree(d_counts);
     cudaFree(d_sums);
     cudaFree(d_changed);
+
+    return maxEpochs > 0 ? h_changed : 0;
 }
@@ -6,7 +6,13 @@
 extern "C" {
 #endif
 
-void run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_points, int k, int maxEpochs, int D);
+// Run up to maxEpochs epochs of k-means over num_points points of D floats, starting from the given
+// assignments (-1 for unassigned points). On return, sums [k * D] and counts [k] hold the per-cluster
+// sums and counts of the points under the final assignments, so callers can merge them across processes
+// without another pass over the points. Returns the number of points that changed cluster in the last epoch.
+// Implemented with CUDA in cluster.cu and with OpenMP in cluster_omp.c.
+int run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_points, int k, int maxEpochs, int D,
+                   double* sums, long long* counts);
 
 #ifdef __cplusplus
 }
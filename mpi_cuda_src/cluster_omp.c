@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <omp.h>
+#include "cluster.h"
+
+/*
+ * OpenMP implementation of run_kmeans_gpu for CPU-only nodes, with the same behaviour as cluster.cu:
+ * clusters without points keep their centroid.
+ */
+
+static float squared_distance(const float* a, const float* b, int D) {
+    float dist = 0.0f;
+    for (int i = 0; i < D; ++i) {
+        float diff = a[i] - b[i];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+int run_kmeans_gpu(float* coords, int* assignments, float* centroids, int num_points, int k, int maxEpochs, int D,
+                   double* sums, long long* counts) {
+    memset(sums, 0, k * D * sizeof(double));
+    memset(counts, 0, k * sizeof(long long));
+
+    int changed = 1;
+    for (int epoch = 0; epoch < maxEpochs && changed > 0; epoch++) {
+        changed = 0;
+        memset(sums, 0, k * D * sizeof(double));
+        memset(counts, 0, k * sizeof(long long));
+
+        #pragma omp parallel
+        {
+            // per-thread sums, merged once per epoch
+            double* local_sums = calloc(k * D, sizeof(double));
+            long long* local_counts = calloc(k, sizeof(long long));
+
+            #pragma omp for schedule(static) reduction(+:changed)
+            for (int idx = 0; idx < num_points; idx++) {
+                const float* point = &coords[idx * D];
+                float min_dist = FLT_MAX;
+                int min_cluster = -1;
+                for (int i = 0; i < k; ++i) {
+                    float dist = squared_distance(point, &centroids[i * D], D);
+                    if (dist < min_dist) {
+                        min_dist = dist;
+                        min_cluster = i;
+                    }
+                }
+                if (assignments[idx] != min_cluster) {
+                    changed++;
+                    assignments[idx] = min_cluster;
+                }
+                if (min_cluster < 0) continue;
+                local_counts[min_cluster]++;
+                for (int d = 0; d < D; ++d) {
+                    local_sums[min_cluster * D + d] += point[d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int i = 0; i < k * D; i++) {
+                    sums[i] += local_sums[i];
+                }
+                for (int i = 0; i < k; i++) {
+                    counts[i] += local_counts[i];
+                }
+            }
+            free(local_sums);
+            free(local_counts);
+        }
+
+        for (int i = 0; i < k; i++) {
+            if (counts[i] == 0) continue;
+            for (int d = 0; d < D; ++d) {
+                centroids[i * D + d] = sums[i * D + d] / counts[i];
+            }
+        }
+    }
+
+    return maxEpochs > 0 ? changed : 0;
+}
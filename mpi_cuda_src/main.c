@@ -152,7 +152,7 @@ int main(int argc, char *argv[]) {
     setup_and_scatter_csv(argc, argv, rank, processes);
 
     // Each MPI process now has the same list of centroids and its own list of points
-    // Now, have each MPI process use a CUDA kernel to simulate an epoch
+    // Now, have each MPI process use a CUDA kernel (or OpenMP on CPU-only nodes) to simulate an epoch
     float* coords = malloc(num_points * DIMENSIONS * sizeof(float));
     int* assignments = malloc(num_points * sizeof(int));
     float* centroid_array = malloc(k * DIMENSIONS * sizeof(float));
@@ -170,22 +170,37 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Synchronize centroids across all processes using MPI_Allreduce
-    // We use MPI_Allreduce to compute the global centroid for each cluster (mean of all centroids)
+    // Synchronize centroids across all processes: every process reduces the sum and number of its points
+    // in each cluster, so the global centroid is the mean over all points, weighted by each process's share
     float* global_centroids = malloc(k * DIMENSIONS * sizeof(float));
+    double* local_sums = malloc(k * DIMENSIONS * sizeof(double));
+    double* global_sums = malloc(k * DIMENSIONS * sizeof(double));
+    long long* local_counts = malloc(k * sizeof(long long));
+    long long* global_counts = malloc(k * sizeof(long long));
+
+    memcpy(global_centroids, centroid_array, k * DIMENSIONS * sizeof(float));
+    for (int i = 0; i < num_points; i++) {
+        assignments[i] = -1;
+    }
 
     for (int epoch = 0; epoch < maxEpochs; epoch++) {
 
-        // Run the CUDA-based K-means algorithm
-        run_kmeans_gpu(coords, assignments, centroid_array, num_points, k, 1, DIMENSIONS); // 1 epoch at a time
+        // Run the K-means algorithm (CUDA or OpenMP) for one epoch from the global centroids; it also
+        // returns this process's per-cluster sums and counts, so only the reduction is left here
+        memcpy(centroid_array, global_centroids, k * DIMENSIONS * sizeof(float));
+        int local_changed = run_kmeans_gpu(coords, assignments, centroid_array, num_points, k, 1, DIMENSIONS,
+                                           local_sums, local_counts) > 0; // 1 epoch at a time
+        int any_changed = 0;
 
-        MPI_Allreduce(centroid_array, global_centroids, k * DIMENSIONS, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(local_sums, global_sums, k * DIMENSIONS, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(local_counts, global_counts, k, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(&local_changed, &any_changed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
 
-        // Now we divide by the number of processes to get the average centroid
-        // TODO: THIS SHOULD BE A WEIGHTED AVERAGE USING THE NUMBER OF POINTS PER PROCESS!
+        // Clusters without points on any process keep their centroid
         for (int i = 0; i < k; i++) {
+            if (global_counts[i] == 0) continue;
             for (int j = 0; j < DIMENSIONS; j++) {
-                global_centroids[i * DIMENSIONS + j] /= processes;  // Calculate average across all processes
+                global_centroids[i * DIMENSIONS + j] = global_sums[i * DIMENSIONS + j] / global_counts[i];
             }
         }
 
@@ -200,14 +215,18 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        // Now, update the centroids with the synchronized global centroids
-        for (int i = 0; i < k; i++) {
-            for (int j = 0; j < DIMENSIONS; j++) {
-                centroid_array[i * DIMENSIONS + j] = centroids[i].dim[j];
+        if (!any_changed) {
+            if (!rank) {
+                printf("Converged after %d epochs\n", epoch);
             }
+            break;
         }
     }
 
+    free(local_sums);
+    free(global_sums);
+    free(local_counts);
+    free(global_counts);
     free(global_centroids);  // Clean up
 
     printf("Process %d finished running K-means\n", rank);
@@ -0,0 +1,53 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/* --- BoundedQueue ----
+ * A blocking producer/consumer queue holding at most `capacity` items.
+ * push blocks while the queue is full, pop blocks while it is empty.
+ * Once close() is called, push is ignored and pop returns false after the remaining items are drained.
+ */
+template <class T>
+class BoundedQueue {
+  public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+    return true;
+  }
+
+  bool pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty()) {
+      return false;
+    }
+    *item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+  }
+
+  private:
+  size_t capacity;
+  bool closed;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+};
@@ -0,0 +1,293 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <stdexcept>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "checkpoint.hpp"
+
+static const char CHECKPOINT_MAGIC[8] = {'G', 'R', 'P', 'C', 'K', 'P', 'T', '2'};
+
+/* --- fingerprintInput ----
+ * FNV-1a hash of the input's path, size and modification time; 0 if there is no input.
+ */
+static uint64_t fingerprintInput(const std::string& filepath) {
+    if (filepath.empty()) {
+        return 0;
+    }
+    struct stat status;
+    uint64_t values[2] = {0, 0};
+    if (stat(filepath.c_str(), &status) == 0) {
+        values[0] = static_cast<uint64_t>(status.st_size);
+        values[1] = static_cast<uint64_t>(status.st_mtime);
+    }
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(filepath.data(), filepath.size());
+    mix(values, sizeof(values));
+    return hash;
+}
+
+/* --- ChecksumWriter / ChecksumReader ----
+ * Binary I/O that keeps an FNV-1a hash of every byte written or read.
+ */
+struct ChecksumWriter {
+    std::ofstream& out;
+    uint32_t hash = 2166136261u;
+
+    explicit ChecksumWriter(std::ofstream& out) : out(out) {}
+
+    void write(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        out.write(static_cast<const char*>(data), size);
+    }
+
+    template <class T>
+    void writeVector(const std::vector<T>& values) {
+        const uint64_t size = values.size();
+        write(&size, sizeof(size));
+        write(values.data(), size * sizeof(T));
+    }
+};
+
+struct ChecksumReader {
+    std::ifstream& in;
+    uint32_t hash = 2166136261u;
+
+    explicit ChecksumReader(std::ifstream& in) : in(in) {}
+
+    bool read(void* data, size_t size) {
+        if (!in.read(static_cast<char*>(data), size)) {
+            return false;
+        }
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return true;
+    }
+
+    template <class T>
+    bool readVector(std::vector<T>* values) {
+        uint64_t size;
+        if (!read(&size, sizeof(size)) || size > (1ull << 40) / sizeof(T)) {
+            return false;
+        }
+        values->resize(size);
+        return read(values->data(), size * sizeof(T));
+    }
+};
+
+Checkpointer::Checkpointer(const CheckpointConfig& config, std::string kind, int shard, int shardCount)
+    : config(config), kind(kind), shard(shard), shardCount(shardCount), inputFingerprint(fingerprintInput(config.input)),
+      rows(0), k(0), dimensions(0), nextSlot(0), lastSave(std::chrono::steady_clock::now()) {
+    if (enabled() && !config.resume) {
+        std::remove(slotPath(0).c_str());
+        std::remove(slotPath(1).c_str());
+    }
+}
+
+void Checkpointer::setShape(size_t rows, int k, int dimensions) {
+    this->rows = rows;
+    this->k = k;
+    this->dimensions = dimensions;
+}
+
+std::string Checkpointer::slotPath(int slot) const {
+    return config.path + "." + std::to_string(slot) + ".shard" + std::to_string(shard);
+}
+
+bool Checkpointer::due(int epoch) const {
+    if (!enabled()) {
+        return false;
+    }
+    if (config.everyEpochs > 0 && (epoch + 1) % config.everyEpochs == 0) {
+        return true;
+    }
+    if (config.everySeconds > 0.0) {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastSave).count();
+        return elapsed >= config.everySeconds;
+    }
+    return false;
+}
+
+void Checkpointer::save(const Checkpoint& checkpoint) {
+    const std::string filepath = slotPath(nextSlot);
+    const std::string partialPath = filepath + ".tmp";
+    {
+        std::ofstream out(partialPath, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Checkpointer::save: could not open " + partialPath);
+        }
+        out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        ChecksumWriter writer(out);
+        const uint32_t kindLength = kind.size();
+        writer.write(&kindLength, sizeof(kindLength));
+        writer.write(kind.data(), kindLength);
+        const int32_t header[5] = {shard, shardCount, checkpoint.epoch, k, dimensions};
+        writer.write(header, sizeof(header));
+        const uint64_t identity[2] = {rows, inputFingerprint};
+        writer.write(identity, sizeof(identity));
+        writer.writeVector(checkpoint.centroids);
+        writer.writeVector(checkpoint.sums);
+        writer.writeVector(checkpoint.counts);
+        writer.writeVector(checkpoint.clusters);
+        writer.writeVector(checkpoint.minDistances);
+        out.write(reinterpret_cast<const char*>(&writer.hash), sizeof(writer.hash));
+        if (!out.flush()) {
+            throw std::runtime_error("Checkpointer::save: failed writing " + partialPath);
+        }
+    }
+    if (std::rename(partialPath.c_str(), filepath.c_str()) != 0) {
+        throw std::runtime_error("Checkpointer::save: could not replace " + filepath);
+    }
+    nextSlot = 1 - nextSlot;
+    lastSave = std::chrono::steady_clock::now();
+}
+
+bool Checkpointer::read(std::string filepath, Checkpoint* checkpoint) const {
+    std::ifstream in(filepath, std::ios::binary);
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    if (!in || !in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))) {
+        return false;
+    }
+    ChecksumReader reader(in);
+    uint32_t kindLength;
+    if (!reader.read(&kindLength, sizeof(kindLength)) || kindLength != kind.size()) {
+        return false;
+    }
+    std::string fileKind(kindLength, '\0');
+    int32_t header[5];
+    uint64_t identity[2];
+    if (!reader.read(&fileKind[0], kindLength) || fileKind != kind || !reader.read(header, sizeof(header)) ||
+        !reader.read(identity, sizeof(identity))) {
+        return false;
+    }
+    if (header[0] != shard || header[1] != shardCount || header[3] != k || header[4] != dimensions ||
+        identity[0] != rows || identity[1] != inputFingerprint) {
+        return false;
+    }
+    checkpoint->epoch = header[2];
+    if (!reader.readVector(&checkpoint->centroids) || !reader.readVector(&checkpoint->sums) ||
+        !reader.readVector(&checkpoint->counts) || !reader.readVector(&checkpoint->clusters) ||
+        !reader.readVector(&checkpoint->minDistances)) {
+        return false;
+    }
+    uint32_t checksum;
+    if (!in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum)) || checksum != reader.hash) {
+        return false;
+    }
+    // the centroid state is only kept on some shards (the MPI root), but is complete where it is kept
+    const size_t values = static_cast<size_t>(k) * dimensions;
+    const bool hasCentroids = !checkpoint->centroids.empty();
+    return checkpoint->clusters.size() == rows && checkpoint->minDistances.size() == rows &&
+           checkpoint->centroids.size() == (hasCentroids ? values : 0) &&
+           checkpoint->sums.size() == (hasCentroids ? values : 0) &&
+           checkpoint->counts.size() == (hasCentroids ? static_cast<size_t>(k) : 0);
+}
+
+std::vector<int> Checkpointer::validEpochs() const {
+    std::vector<int> epochs;
+    for (int slot = 0; slot < 2; slot++) {
+        Checkpoint checkpoint;
+        if (read(slotPath(slot), &checkpoint)) {
+            epochs.push_back(checkpoint.epoch);
+        }
+    }
+    if (epochs.size() == 2 && epochs[1] > epochs[0]) {
+        std::swap(epochs[0], epochs[1]);
+    }
+    return epochs;
+}
+
+Checkpoint Checkpointer::load(int epoch) {
+    for (int slot = 0; slot < 2; slot++) {
+        Checkpoint checkpoint;
+        if (read(slotPath(slot), &checkpoint) && checkpoint.epoch == epoch) {
+            // keep this checkpoint until the next one is complete
+            nextSlot = 1 - slot;
+            return checkpoint;
+        }
+    }
+    throw std::runtime_error("Checkpointer::load: no valid checkpoint of epoch " + std::to_string(epoch) + " at " + config.path);
+}
+
+bool Checkpointer::resume(Checkpoint* checkpoint) {
+    if (!resuming()) {
+        return false;
+    }
+    for (int epoch : validEpochs()) {
+        //read() checked the shape and input; a single process run also needs the centroid state
+        Checkpoint candidate = load(epoch);
+        if (!candidate.centroids.empty()) {
+            *checkpoint = candidate;
+            std::cout << "Resuming from the checkpoint at epoch " << checkpoint->epoch << "." << std::endl;
+            return true;
+        }
+    }
+    std::cout << "No valid checkpoint at " << config.path << ", starting from the first epoch." << std::endl;
+    return false;
+}
+
+void storeLabels(const std::vector<Point>& points, Checkpoint* checkpoint) {
+    checkpoint->clusters.resize(points.size());
+    checkpoint->minDistances.resize(points.size());
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(points.size()); i++) {
+        checkpoint->clusters[i] = points[i].cluster;
+        checkpoint->minDistances[i] = points[i].minDistance;
+    }
+}
+
+void restoreLabels(const Checkpoint& checkpoint, std::vector<Point>* points) {
+    if (checkpoint.clusters.size() != points->size()) {
+        throw std::runtime_error("restoreLabels: the checkpoint has a different number of points");
+    }
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(points->size()); i++) {
+        points->at(i).cluster = checkpoint.clusters[i];
+        points->at(i).minDistance = checkpoint.minDistances[i];
+    }
+}
+
+void storeCentroids(const std::vector<Point>& centroids, Checkpoint* checkpoint) {
+    checkpoint->centroids.clear();
+    for (const Point& centroid : centroids) {
+        checkpoint->centroids.insert(checkpoint->centroids.end(), centroid.coordinates.begin(), centroid.coordinates.end());
+    }
+}
+
+void restoreCentroids(const Checkpoint& checkpoint, std::vector<Point>* centroids) {
+    size_t values = 0;
+    for (const Point& centroid : *centroids) {
+        values += centroid.coordinates.size();
+    }
+    if (centroids->empty() || checkpoint.centroids.size() != values) {
+        throw std::runtime_error("restoreCentroids: the checkpoint has a different number of clusters or dimensions");
+    }
+    size_t next = 0;
+    for (Point& centroid : *centroids) {
+        for (float& coordinate : centroid.coordinates) {
+            coordinate = checkpoint.centroids[next++];
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include "point.hpp"
+
+/* --- CheckpointConfig ----
+ *   path // checkpoint files are written next to this path; empty disables checkpoints
+ *   input // path of the input being clustered; checkpoints of another input (path, size or modification time) are ignored
+ *   everyEpochs // checkpoint after every this many epochs, 0 for never
+ *   everySeconds // checkpoint after the first epoch that ends this long after the last checkpoint, 0 for never
+ *   resume // continue from the latest valid checkpoint, if there is one
+ */
+struct CheckpointConfig {
+  std::string path;
+  std::string input;
+  int everyEpochs = 0;
+  double everySeconds = 0.0;
+  bool resume = false;
+};
+
+/* --- Checkpoint ----
+ * Everything an engine needs to continue a run after an epoch exactly as if it had not stopped.
+ * No random numbers are drawn after seeding, so the centroids carry the RNG state.
+ *   epoch // the next epoch to run
+ *   centroids // [k][dimensions]; may be empty on the shards of non-root MPI processes
+ *   sums, counts // running per-cluster sums [k][dimensions] and counts; may be empty like centroids
+ *   clusters, minDistances // cluster and distance bound of every point in this shard
+ */
+struct Checkpoint {
+  int epoch = 0;
+  std::vector<float> centroids;
+  std::vector<double> sums;
+  std::vector<long long> counts;
+  std::vector<int> clusters;
+  std::vector<float> minDistances;
+};
+
+/* --- Checkpointer ----
+ * Writes the checkpoints of one shard of a run (one per MPI process) and finds them again.
+ * Each shard alternates between two files, <path>.<slot>.shard<shard>, replacing one atomically
+ * (write then rename), so a run preempted mid-write still has the other checkpoint.
+ * `kind` names the engine and algorithm; checkpoints of a different kind, of another input, or of a
+ * run with a different shape (see setShape) are ignored.
+ * A run that does not resume deletes the shard's old checkpoints first.
+ *
+ * File format (native endianness):
+ *   8 byte magic "GRPCKPT2", then a uint32 length prefixed kind, int32 shard, int32 shardCount,
+ *   int32 epoch, int32 k, int32 dimensions, uint64 rows, uint64 input fingerprint, then centroids,
+ *   sums, counts, clusters and minDistances each as a uint64 length followed by the values, and a
+ *   uint32 FNV-1a checksum of everything after the magic.
+ */
+class Checkpointer {
+  public:
+  Checkpointer(const CheckpointConfig& config, std::string kind, int shard = 0, int shardCount = 1);
+
+  bool enabled() const { return !config.path.empty(); }
+  bool resuming() const { return enabled() && config.resume; }
+  /* Whether the decision to checkpoint depends on the clock (so MPI processes must agree on it). */
+  bool timed() const { return config.everySeconds > 0.0; }
+
+  /* --- setShape ----
+   * Describe the run: points in this shard, clusters and dimensions. Must be called before
+   * save, validEpochs and resume; checkpoints of another shape are not valid.
+   */
+  void setShape(size_t rows, int k, int dimensions);
+
+  /* Whether to checkpoint after the given (zero based) epoch. */
+  bool due(int epoch) const;
+
+  /* Write a checkpoint. Throws std::runtime_error on I/O errors. */
+  void save(const Checkpoint& checkpoint);
+
+  /* Epochs of the valid checkpoints of this shard, newest first. */
+  std::vector<int> validEpochs() const;
+
+  /* Read this shard's checkpoint of the given epoch (one of validEpochs). */
+  Checkpoint load(int epoch);
+
+  /* --- resume ----
+   * Single process runs: if resuming, load the latest valid checkpoint (of this shape and input,
+   * with its centroid state) into checkpoint, so engines can restore it without further checks.
+   * Return: whether a checkpoint was loaded; false means starting from the first epoch.
+   */
+  bool resume(Checkpoint* checkpoint);
+
+  private:
+  std::string slotPath(int slot) const;
+  bool read(std::string filepath, Checkpoint* checkpoint) const;
+
+  CheckpointConfig config;
+  std::string kind;
+  int shard;
+  int shardCount;
+  uint64_t inputFingerprint;
+  size_t rows;
+  int k;
+  int dimensions;
+  int nextSlot;
+  std::chrono::steady_clock::time_point lastSave;
+};
+
+/* --- storeLabels / restoreLabels ----
+ * Copy the cluster and minDistance of every point into or out of a checkpoint.
+ */
+void storeLabels(const std::vector<Point>& points, Checkpoint* checkpoint);
+void restoreLabels(const Checkpoint& checkpoint, std::vector<Point>* points);
+
+/* --- storeCentroids / restoreCentroids ----
+ * Copy centroids into or out of a checkpoint. restoreCentroids throws std::runtime_error if the
+ * checkpoint has a different number of clusters or dimensions.
+ */
+void storeCentroids(const std::vector<Point>& centroids, Checkpoint* checkpoint);
+void restoreCentroids(const Checkpoint& checkpoint, std::vector<Point>* centroids);
@@ -0,0 +1,307 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "point.hpp"
+#include "clustering.hpp"
+#include "shared_cluster.hpp"
+#include "placement.hpp"
+#ifdef GRP_HAVE_MPI
+#include <boost/mpi/environment.hpp>
+#include <boost/mpi/communicator.hpp>
+#include <boost/mpi/collectives.hpp>
+#include <boost/serialization/vector.hpp>
+#include "distributed_cluster.hpp"
+#endif
+#ifdef GRP_HAVE_CUDA
+#include "cuda_cluster.hpp"
+#endif
+
+/* --- setThreadCount ----
+ * Use threadCount OpenMP threads, or defaultCount if threadCount is 0, pinned as configured
+ * (slot: see pinThreads).
+ */
+static void setThreadCount(int threadCount, int defaultCount, ThreadPlacement placement, int slot = 0) {
+    #ifdef _OPENMP
+    omp_set_num_threads(threadCount > 0 ? threadCount : defaultCount);
+    #else
+    (void)threadCount;
+    (void)defaultCount;
+    #endif
+    pinThreads(placement, slot);
+}
+
+static int processorCount() {
+    #ifdef _OPENMP
+    return omp_get_num_procs();
+    #else
+    return 1;
+    #endif
+}
+
+/* --- SharedEngine ----
+ * Serial and OpenMP backends: the shared memory implementation in shared_cluster.cpp,
+ * run with one thread or with a team of threads.
+ */
+class SharedEngine : public ClusteringEngine {
+  public:
+    SharedEngine(Backend backend, const ClusterConfig& config) : selectedBackend(backend), algorithm(config.algorithm), checkpoint(config.checkpoint) {
+        if (backend == Backend::Serial) {
+            setThreadCount(1, 1, config.placement);
+        }
+        else {
+            setThreadCount(config.threadCount, processorCount(), config.placement);
+        }
+    }
+
+    Backend backend() const override { return selectedBackend; }
+
+    void cluster(std::vector<Point>* points, std::vector<Point>* centroids, int k, int maxEpochs) override {
+        if (points->empty() || maxEpochs <= 0) {
+            return;
+        }
+        if (centroids->empty()) {
+            *centroids = seedCentroids(*points, k);
+        }
+        //serial and OpenMP runs are identical, so they can resume each other's checkpoints
+        Checkpointer checkpointer(checkpoint, algorithm == Algorithm::Lloyd ? "lloyd" : "standard");
+        Checkpointer* activeCheckpointer = checkpointer.enabled() ? &checkpointer : NULL;
+        if (algorithm == Algorithm::Lloyd) {
+            lloydCluster(points, maxEpochs, centroids, activeCheckpointer);
+        }
+        else {
+            kMeansCluster(points, maxEpochs, centroids, activeCheckpointer);
+        }
+    }
+
+  private:
+    Backend selectedBackend;
+    Algorithm algorithm;
+    CheckpointConfig checkpoint;
+};
+
+#ifdef GRP_HAVE_MPI
+/* --- placementSlot ----
+ * Index of this process among the processes of its node allowed on the same CPUs, so pinThreads
+ * gives each of them its own cores. Processes the launcher bound to different cores all get slot 0.
+ */
+static int placementSlot(const boost::mpi::communicator& world) {
+    MPI_Comm shared;
+    MPI_Comm_split_type(world, MPI_COMM_TYPE_SHARED, world.rank(), MPI_INFO_NULL, &shared);
+    boost::mpi::communicator node(shared, boost::mpi::comm_take_ownership);
+    std::vector<std::vector<int>> masks;
+    boost::mpi::all_gather(node, allowedCpus(), masks);
+    int slot = 0;
+    for (int rank = 0; rank < node.rank(); rank++) {
+        if (masks[rank] == masks[node.rank()]) {
+            slot++;
+        }
+    }
+    return slot;
+}
+
+/* --- DistributedEngine ----
+ * MPI backend: distributed_cluster.cpp over MPI_COMM_WORLD. Points live on the root process.
+ */
+class DistributedEngine : public ClusteringEngine {
+  public:
+    explicit DistributedEngine(const ClusterConfig& config) : checkpoint(config.checkpoint) {
+        //ranks sharing a node and its cores must not pin onto the same ones
+        const int slot = config.placement == ThreadPlacement::None ? 0 : placementSlot(world);
+        setThreadCount(config.threadCount, 1, config.placement, slot);
+    }
+
+    Backend backend() const override { return Backend::MPI; }
+    bool isDistributed() const override { return true; }
+    int rank() const override { return world.rank(); }
+
+    void cluster(std::vector<Point>* points, std::vector<Point>* centroids, int k, int maxEpochs) override {
+        //only the root knows whether it is warm-starting
+        if (world.rank() == 0 && !centroids->empty()) {
+            k = centroids->size();
+        }
+        boost::mpi::broadcast(world, k, 0);
+        if (world.rank() != 0) {
+            centroids->clear();
+        }
+        Checkpointer checkpointer(checkpoint, "mpi", world.rank(), world.size());
+        determineClusters(world, points, k, maxEpochs, centroids, checkpointer.enabled() ? &checkpointer : NULL);
+    }
+
+  private:
+    boost::mpi::communicator world;
+    CheckpointConfig checkpoint;
+};
+#endif
+
+#ifdef GRP_HAVE_CUDA
+/* --- CudaEngine ----
+ * CUDA backend: cuda_cluster.cu on the default device.
+ */
+class CudaEngine : public ClusteringEngine {
+  public:
+    explicit CudaEngine(const ClusterConfig& config) : blockSize(config.blockSize), checkpoint(config.checkpoint) {
+        setThreadCount(config.threadCount, 1, config.placement);
+    }
+
+    Backend backend() const override { return Backend::CUDA; }
+
+    void cluster(std::vector<Point>* points, std::vector<Point>* centroids, int k, int maxEpochs) override {
+        if (!centroids->empty()) {
+            k = centroids->size();
+        }
+        Checkpointer checkpointer(checkpoint, "cuda");
+        kMeansCluster(points, maxEpochs, k, blockSize, centroids, checkpointer.enabled() ? &checkpointer : NULL);
+    }
+
+  private:
+    int blockSize;
+    CheckpointConfig checkpoint;
+};
+#endif
+
+std::vector<Point> seedCentroids(const std::vector<Point>& points, int k) {
+    std::vector<Point> centroids;
+    if (points.empty()) {
+        return centroids;
+    }
+    std::srand(100); // for consistency
+    for (int i = 0; i < k; i++) {
+        centroids.push_back(points.at(rand() % points.size()));
+    }
+    return centroids;
+}
+
+std::vector<Point> seedWeightedCentroids(const std::vector<Point>& points, const std::vector<double>& weights, int k) {
+    std::vector<Point> centroids;
+    if (points.empty()) {
+        return centroids;
+    }
+    std::vector<double> cumulative(weights.size());
+    std::partial_sum(weights.begin(), weights.end(), cumulative.begin());
+    std::mt19937_64 random(100); // for consistency
+    std::uniform_real_distribution<double> uniform(0.0, cumulative.back());
+    for (int i = 0; i < k; i++) {
+        const size_t index = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(random)) - cumulative.begin();
+        centroids.push_back(points.at(std::min(index, points.size() - 1)));
+    }
+    return centroids;
+}
+
+void ClusteringEngine::clusterWeighted(std::vector<Point>* points, const std::vector<double>& weights, std::vector<Point>* centroids, int k, int maxEpochs) {
+    if (weights.size() != points->size()) {
+        throw std::invalid_argument("ClusteringEngine::clusterWeighted: every point needs a weight");
+    }
+    if (points->empty() || maxEpochs <= 0) {
+        return;
+    }
+    if (centroids->empty()) {
+        *centroids = seedWeightedCentroids(*points, weights, k);
+    }
+    weightedLloydCluster(points, weights, maxEpochs, centroids);
+}
+
+/* --- mpiProcessCount ----
+ * Number of processes in MPI_COMM_WORLD, or 1 if MPI is not built in or not initialized.
+ */
+static int mpiProcessCount() {
+    #ifdef GRP_HAVE_MPI
+    if (boost::mpi::environment::initialized()) {
+        return boost::mpi::communicator().size();
+    }
+    #endif
+    return 1;
+}
+
+Backend selectBackend(Backend requested) {
+    switch (requested) {
+        case Backend::Serial:
+        case Backend::OpenMP:
+            return requested;
+        case Backend::MPI:
+            #ifdef GRP_HAVE_MPI
+            if (!boost::mpi::environment::initialized()) {
+                throw std::invalid_argument("selectBackend: MPI has not been initialized");
+            }
+            return requested;
+            #else
+            throw std::invalid_argument("selectBackend: built without the MPI backend");
+            #endif
+        case Backend::CUDA:
+            #ifdef GRP_HAVE_CUDA
+            if (!cudaDeviceAvailable()) {
+                throw std::invalid_argument("selectBackend: no CUDA device available");
+            }
+            return requested;
+            #else
+            throw std::invalid_argument("selectBackend: built without the CUDA backend");
+            #endif
+        case Backend::Auto:
+            break;
+    }
+    if (mpiProcessCount() > 1) {
+        return Backend::MPI;
+    }
+    #ifdef GRP_HAVE_CUDA
+    if (cudaDeviceAvailable()) {
+        return Backend::CUDA;
+    }
+    #endif
+    return processorCount() > 1 ? Backend::OpenMP : Backend::Serial;
+}
+
+std::unique_ptr<ClusteringEngine> makeEngine(const ClusterConfig& config) {
+    const Backend backend = selectBackend(config.backend);
+    if (config.algorithm != Algorithm::Standard && backend != Backend::Serial && backend != Backend::OpenMP) {
+        throw std::invalid_argument("makeEngine: the " + backendName(backend) + " backend only supports the standard algorithm");
+    }
+    switch (backend) {
+        #ifdef GRP_HAVE_MPI
+        case Backend::MPI:
+            return std::unique_ptr<ClusteringEngine>(new DistributedEngine(config));
+        #endif
+        #ifdef GRP_HAVE_CUDA
+        case Backend::CUDA:
+            return std::unique_ptr<ClusteringEngine>(new CudaEngine(config));
+        #endif
+        default:
+            return std::unique_ptr<ClusteringEngine>(new SharedEngine(backend, config));
+    }
+}
+
+std::string backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Auto: return "auto";
+        case Backend::Serial: return "serial";
+        case Backend::OpenMP: return "omp";
+        case Backend::MPI: return "mpi";
+        case Backend::CUDA: return "cuda";
+    }
+    return "unknown";
+}
+
+Backend parseBackend(std::string name) {
+    for (Backend backend : {Backend::Auto, Backend::Serial, Backend::OpenMP, Backend::MPI, Backend::CUDA}) {
+        if (backendName(backend) == name) {
+            return backend;
+        }
+    }
+    throw std::invalid_argument("unknown backend " + name + " (expected auto, serial, omp, mpi or cuda)");
+}
+
+Algorithm parseAlgorithm(std::string name) {
+    if (name == "standard") {
+        return Algorithm::Standard;
+    }
+    if (name == "lloyd") {
+        return Algorithm::Lloyd;
+    }
+    throw std::invalid_argument("unknown algorithm " + name + " (expected standard or lloyd)");
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "point.hpp"
+#include "placement.hpp"
+#include "checkpoint.hpp"
+
+/* --- Backend ----
+ * Where the clustering runs. Auto picks the fastest backend available at runtime.
+ * MPI and CUDA are only available if the library was built with them (GRP_HAVE_MPI / GRP_HAVE_CUDA).
+ */
+enum class Backend { Auto, Serial, OpenMP, MPI, CUDA };
+
+/* --- Algorithm ----
+ *   Standard // the original algorithm of every backend: a point only moves to a centroid that is
+ *            // closer than the smallest distance it has seen so far
+ *   Lloyd // every epoch each point moves to its exact nearest centroid (Serial and OpenMP only)
+ */
+enum class Algorithm { Standard, Lloyd };
+
+/* --- ClusterConfig ----
+ *   threadCount // OpenMP threads; 0 uses every processor for the OpenMP backend and 1 for the others
+ *   placement // how OpenMP threads are pinned to cores
+ *   blockSize // CUDA threads per block
+ *   checkpoint // periodic checkpoints of the epochs, and whether to resume from them
+ */
+struct ClusterConfig {
+  int k = 5;
+  int maxEpochs = 200;
+  int threadCount = 0;
+  ThreadPlacement placement = ThreadPlacement::None;
+  int blockSize = 32;
+  Backend backend = Backend::Auto;
+  Algorithm algorithm = Algorithm::Standard;
+  CheckpointConfig checkpoint;
+};
+
+/* --- ClusteringEngine ----
+ * A backend configured to run one algorithm. Create one with makeEngine.
+ */
+class ClusteringEngine {
+  public:
+  virtual ~ClusteringEngine() {}
+
+  virtual Backend backend() const = 0;
+
+  /* Distributed engines only read points on the root process (rank 0) and return results there. */
+  virtual bool isDistributed() const { return false; }
+  virtual int rank() const { return 0; }
+
+  /* --- cluster ----
+   * Args:
+   *   std::vector<Point>* points // in and out; points keep their cluster and minDistance as a starting point
+   *   std::vector<Point>* centroids // in and out: centroids to refine, or empty to seed k random points; the final centroids
+   *   int k // in, ignored when centroids are given
+   *   int maxEpochs // in
+   */
+  virtual void cluster(std::vector<Point>* points, std::vector<Point>* centroids, int k, int maxEpochs) = 0;
+
+  /* --- clusterWeighted ----
+   * Weighted k-means (Lloyd) on a small weighted point set such as a coreset. Called on every
+   * process like cluster; distributed engines get the points on the root process only.
+   * The default runs weightedLloydCluster on the process holding the points with the engine's
+   * threads. None of the built-in engines override it (the MPI engine clusters on the root and the
+   * CUDA engine on the host): the set is too small to be worth distributing or copying to a device.
+   * Args:
+   *   std::vector<Point>* points // in and out
+   *   const std::vector<double>& weights // in, one per point
+   *   std::vector<Point>* centroids // in and out: centroids to refine, or empty to seed k points with probability proportional to their weight
+   *   int k // in, ignored when centroids are given
+   *   int maxEpochs // in
+   */
+  virtual void clusterWeighted(std::vector<Point>* points, const std::vector<double>& weights, std::vector<Point>* centroids, int k, int maxEpochs);
+};
+
+/* --- makeEngine ----
+ * Resolve config.backend (see selectBackend) and create its engine. Sets the OpenMP thread count
+ * and pins the threads as configured.
+ * Throws std::invalid_argument if the backend or algorithm is not available.
+ */
+std::unique_ptr<ClusteringEngine> makeEngine(const ClusterConfig& config);
+
+/* --- selectBackend ----
+ * Return the requested backend if it is available, or for Backend::Auto: MPI if the program was
+ * launched with more than one MPI process, else CUDA if a device is present, else OpenMP if there
+ * is more than one processor, else Serial.
+ */
+Backend selectBackend(Backend requested);
+
+/* --- seedCentroids ----
+ * Pick k random points as the initial centroids, with a fixed seed for consistent results.
+ */
+std::vector<Point> seedCentroids(const std::vector<Point>& points, int k);
+
+/* --- seedWeightedCentroids ----
+ * Pick k random points with probability proportional to their weight, with a fixed seed.
+ */
+std::vector<Point> seedWeightedCentroids(const std::vector<Point>& points, const std::vector<double>& weights, int k);
+
+std::string backendName(Backend backend);
+Backend parseBackend(std::string name);
+Algorithm parseAlgorithm(std::string name);
@@ -0,0 +1,245 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "point.hpp"
+#include "feature_stream.hpp"
+#include "coreset.hpp"
+#ifdef GRP_HAVE_MPI
+#include <boost/mpi/communicator.hpp>
+#include <boost/mpi/collectives.hpp>
+#include <boost/serialization/vector.hpp>
+#endif
+
+double Coreset::weight() const {
+    double total = 0.0;
+    for (double w : weights) {
+        total += w;
+    }
+    return total;
+}
+
+void Coreset::append(const Coreset& other) {
+    rows += other.rows;
+    if (other.size() == 0) {
+        return;
+    }
+    if (size() == 0) {
+        dimensions = other.dimensions;
+    }
+    else if (other.dimensions != dimensions) {
+        throw std::invalid_argument("Coreset::append: coresets have different dimensions");
+    }
+    coordinates.insert(coordinates.end(), other.coordinates.begin(), other.coordinates.end());
+    weights.insert(weights.end(), other.weights.begin(), other.weights.end());
+}
+
+std::vector<Point> Coreset::points() const {
+    std::vector<Point> points;
+    points.reserve(size());
+    for (size_t i = 0; i < size(); i++) {
+        points.push_back(Point(std::vector<float>(coordinates.begin() + i * dimensions, coordinates.begin() + (i + 1) * dimensions)));
+    }
+    return points;
+}
+
+Coreset reduceCoreset(const Coreset& points, size_t size, uint64_t seed) {
+    const size_t n = points.size();
+    if (n <= size || size == 0) {
+        return points;
+    }
+    const int dimensions = points.dimensions;
+
+    //weighted mean and weighted squared distances to it
+    const double totalWeight = points.weight();
+    std::vector<double> mean(dimensions, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        for (int d = 0; d < dimensions; d++) {
+            mean[d] += points.weights[i] * points.coordinates[i * dimensions + d];
+        }
+    }
+    for (int d = 0; d < dimensions; d++) {
+        mean[d] /= totalWeight;
+    }
+    std::vector<double> costs(n);
+    double totalCost = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double distance = 0.0;
+        for (int d = 0; d < dimensions; d++) {
+            const double diff = points.coordinates[i * dimensions + d] - mean[d];
+            distance += diff * diff;
+        }
+        costs[i] = points.weights[i] * distance;
+        totalCost += costs[i];
+    }
+
+    //sampling distribution q and its cumulative sums
+    std::vector<double> probabilities(n);
+    std::vector<double> cumulative(n);
+    double running = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        probabilities[i] = totalCost > 0.0
+            ? 0.5 * points.weights[i] / totalWeight + 0.5 * costs[i] / totalCost
+            : points.weights[i] / totalWeight;
+        running += probabilities[i];
+        cumulative[i] = running;
+    }
+
+    //sample `size` points with replacement, weight w / (size * q), and merge repeated picks
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> uniform(0.0, running);
+    std::map<size_t, double> sampled;
+    for (size_t s = 0; s < size; s++) {
+        const size_t i = std::min<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), uniform(random)) - cumulative.begin(), n - 1);
+        sampled[i] += points.weights[i] / (size * probabilities[i]);
+    }
+    Coreset reduced;
+    reduced.rows = points.rows;
+    reduced.dimensions = dimensions;
+    for (const auto& sample : sampled) {
+        reduced.coordinates.insert(reduced.coordinates.end(), points.coordinates.begin() + sample.first * dimensions, points.coordinates.begin() + (sample.first + 1) * dimensions);
+        reduced.weights.push_back(sample.second);
+    }
+    return reduced;
+}
+
+/* --- nodeSeed ----
+ * Seed of the reduction of tree node (level, index) of a shard, so the result does not depend on
+ * which thread reduces it.
+ */
+static uint64_t nodeSeed(int shard, int level, size_t index) {
+    return 100 + (static_cast<uint64_t>(shard) << 48) + (static_cast<uint64_t>(level) << 40) + index;
+}
+
+/* --- MergeReduceTree ----
+ * Node (level, index) summarises blocks [index * 2^level, (index + 1) * 2^level). When both children
+ * of a node are done, the thread finishing the second merges and reduces them into the node.
+ */
+class MergeReduceTree {
+  public:
+    MergeReduceTree(size_t size, int shard) : size(size), shard(shard) {}
+
+    void insert(int level, size_t index, Coreset coreset) {
+        while (true) {
+            Coreset sibling;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = nodes.find(std::make_pair(level, index ^ 1));
+                if (found == nodes.end()) {
+                    nodes[std::make_pair(level, index)] = std::move(coreset);
+                    return;
+                }
+                sibling = std::move(found->second);
+                nodes.erase(found);
+            }
+            Coreset merged = (index % 2 == 0) ? std::move(coreset) : std::move(sibling);
+            merged.append((index % 2 == 0) ? sibling : coreset);
+            level++;
+            index /= 2;
+            coreset = reduceCoreset(merged, size, nodeSeed(shard, level, index));
+        }
+    }
+
+    /* Merge the nodes left over (blocks without a sibling) in tree order and reduce once more. */
+    Coreset finish() {
+        Coreset all;
+        for (const auto& node : nodes) {
+            all.append(node.second);
+        }
+        nodes.clear();
+        return reduceCoreset(all, size, nodeSeed(shard, 63, 0));
+    }
+
+  private:
+    size_t size;
+    int shard;
+    std::mutex mutex;
+    std::map<std::pair<int, size_t>, Coreset> nodes;
+};
+
+Coreset buildCoreset(std::string filepath, size_t size, size_t blockRows, int shard, int shardCount) {
+    if (size == 0 || blockRows == 0) {
+        throw std::invalid_argument("buildCoreset: the coreset size and block rows must be positive");
+    }
+    FeatureStream stream(filepath, shard, shardCount);
+    const int dimensions = stream.dimensions();
+    MergeReduceTree tree(size, shard);
+    #ifdef _OPENMP
+    const int threadCount = omp_get_max_threads();
+    #else
+    const int threadCount = 1;
+    #endif
+    //a block in flight per thread and one waiting
+    BlockReader reader(&stream, blockRows, 2 * threadCount);
+
+    std::exception_ptr error;
+    //each thread parses and reduces whole blocks; parse's own parallel loop runs on the calling thread here
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        try {
+            RowBlock block;
+            while (reader.pop(&block)) {
+                stream.parse(&block);
+                Coreset leaf;
+                leaf.rows = block.rows;
+                leaf.dimensions = dimensions;
+                leaf.coordinates = std::move(block.features);
+                leaf.weights.assign(block.rows, 1.0);
+                const size_t index = block.index;
+                block = RowBlock();
+                tree.insert(0, index, reduceCoreset(leaf, size, nodeSeed(shard, 0, index)));
+            }
+        }
+        catch (...) {
+            #ifdef _OPENMP
+            #pragma omp critical
+            #endif
+            error = std::current_exception();
+            reader.close();
+        }
+    }
+    reader.finish();
+
+    if (error) std::rethrow_exception(error);
+    if (reader.error()) std::rethrow_exception(reader.error());
+    Coreset coreset = tree.finish();
+    coreset.dimensions = dimensions;
+    return coreset;
+}
+
+#ifdef GRP_HAVE_MPI
+Coreset buildCoreset(boost::mpi::communicator world, std::string filepath, size_t size, size_t blockRows) {
+    Coreset local = buildCoreset(filepath, size, blockRows, world.rank(), world.size());
+    std::vector<std::vector<float>> coordinates;
+    std::vector<std::vector<double>> weights;
+    std::vector<size_t> rows;
+    boost::mpi::gather(world, local.coordinates, coordinates, 0);
+    boost::mpi::gather(world, local.weights, weights, 0);
+    boost::mpi::gather(world, local.rows, rows, 0);
+    if (world.rank() != 0) {
+        return Coreset();
+    }
+    Coreset all;
+    for (int rank = 0; rank < world.size(); rank++) {
+        Coreset shard;
+        shard.rows = rows[rank];
+        shard.dimensions = local.dimensions;
+        shard.coordinates = coordinates[rank];
+        shard.weights = weights[rank];
+        all.append(shard);
+    }
+    all.dimensions = local.dimensions;
+    return reduceCoreset(all, size, nodeSeed(world.size(), 63, 0));
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "point.hpp"
+#ifdef GRP_HAVE_MPI
+#include <boost/mpi/communicator.hpp>
+#endif
+
+/* --- Coreset ----
+ * A weighted summary of a set of rows: weighted k-means on the summary approximates k-means on the rows.
+ *   rows // exact number of rows summarised
+ *   coordinates // row-major [size][dimensions]
+ *   weights // number of rows each summary point stands for (an estimate: they only sum to about `rows`)
+ */
+struct Coreset {
+  size_t rows = 0;
+  int dimensions = 0;
+  std::vector<float> coordinates;
+  std::vector<double> weights;
+
+  size_t size() const { return weights.size(); }
+  /* Total weight, an estimate of the number of rows summarised. */
+  double weight() const;
+  /* Append the points (and rows) of another coreset. */
+  void append(const Coreset& other);
+  /* The summary points as points, without their weights. */
+  std::vector<Point> points() const;
+};
+
+/* --- reduceCoreset ----
+ * Reduce a weighted point set to at most `size` points with a lightweight coreset: points are
+ * sampled with probability half proportional to their weight and half proportional to their
+ * weighted squared distance to the mean, and reweighted so the sample is an unbiased estimate of
+ * the k-means cost of any set of centroids. Points are drawn `size` times with replacement and a point
+ * drawn more than once becomes one heavier point, so `size` is an upper bound: skewed data gives fewer
+ * points. Sets with at most `size` points are returned as they are. `seed` makes the sample reproducible.
+ */
+Coreset reduceCoreset(const Coreset& points, size_t size, uint64_t seed);
+
+/* --- buildCoreset ----
+ * Summarise a CSV or binary feature file in one pass with a merge-and-reduce tree. Every block of
+ * `blockRows` rows is reduced to a coreset of at most `size` points, and two coresets covering neighbouring
+ * ranges of blocks are merged and reduced again, so at most about size * log2(blocks) summary
+ * points and a few blocks per thread are held at once, however large the input is.
+ * Blocks are parsed and reduced by the OpenMP threads while a reader thread streams the file.
+ * The result only depends on the input and the arguments, not on the thread count.
+ * Args:
+ *   std::string filepath // in
+ *   size_t size // in, largest number of summary points (see reduceCoreset)
+ *   size_t blockRows // in
+ *   int shard, shardCount // in, summarise only this shard of the file (see FeatureStream)
+ */
+Coreset buildCoreset(std::string filepath, size_t size, size_t blockRows, int shard = 0, int shardCount = 1);
+
+#ifdef GRP_HAVE_MPI
+/* --- buildCoreset ----
+ * Every process summarises its own shard of the file; the root process gathers the summaries in
+ * rank order and reduces them to one coreset. Returns an empty coreset on the other processes.
+ */
+Coreset buildCoreset(boost::mpi::communicator world, std::string filepath, size_t size, size_t blockRows);
+#endif
@@ -9,7 +9,10 @@ https://github.com/robertmartin8/RandomWalks/blob/master/kmeans.cpp
 #include <stdexcept>
 #include <cuda_runtime.h>
 #include <iostream>
+#include <algorithm>
 #include "point.hpp"
+#include "kernels.hpp"
+#include "checkpoint.hpp"
 #include <iomanip>
 #define BLOCK_SIZE 256
 
@@ -54,6 +57,32 @@ void computeSums(float* coordinates, int* clusters, float* sums, int* counts, in
 }
 
 
+/* --- computeDeltas ----
+ * Move the points whose cluster changed since the last update from their old cluster's sums and
+ * count to their new cluster's, and remember their new cluster. Only moved points do atomics.
+ */
+__global__
+void computeDeltas(float* coordinates, int* clusters, int* previousClusters, float* sums, int* counts, int num_points, int k, int d) {
+   int idx = blockIdx.x * blockDim.x + threadIdx.x;
+   if(idx >= num_points) return;
+   int cluster = clusters[idx];
+   int previous = previousClusters[idx];
+   if (cluster == previous) return;
+   previousClusters[idx] = cluster;
+   if (previous >= 0 && previous < k) {
+      atomicSub(&counts[previous], 1);
+      for (int dim = 0; dim < d; dim++) {
+         atomicAdd(&sums[previous * d + dim], -coordinates[idx * d + dim]);
+      }
+   }
+   if (cluster < 0  || cluster >= k) return;
+   atomicAdd(&counts[cluster], 1);
+   for (int dim = 0; dim < d; dim++) {
+      atomicAdd(&sums[cluster * d + dim], coordinates[idx * d + dim]);
+   }
+}
+
+
 __global__
 void updateCentroids(float* centroids, float* sums, int* counts, int k, int d) {
    int cluster = blockIdx.x;
@@ -72,8 +101,11 @@ void updateCentroids(float* centroids, float* sums, int* counts, int k, int d) {
  *   std::vector<Point>* points // in and out
  *   int maxEpochs // in
  *   int k // in
+ *   int blockSize // in
+ *   std::vector<Point>* centroids // in and out: warm-start centroids, or empty for random seeds; the final centroids
+ *   Checkpointer* checkpointer // in, may be NULL
  */
-void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSize){
+void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSize, std::vector<Point>* centroids, Checkpointer* checkpointer){
     //bounds checking
     if (points->empty() || k <= 0 || maxEpochs <= 0) return;
     size_t num_points = points->size();
@@ -85,23 +117,46 @@ void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSi
         for (size_t j = 0; j < d; j++) {
             h_coordinates[i * d + j] = points->at(i).coordinates[j];
         }
-        h_clusters[i] = -1;
-        h_minDistances[i] = FLT_MAX;
+        // -1 and FLT_MAX for a cold start; cached labels and bounds for a warm start
+        h_clusters[i] = points->at(i).cluster;
+        h_minDistances[i] = points->at(i).minDistance;
     }
     float* h_centroids = new float[k * d];
-    std::srand(100);
-    for (int i = 0; i < k; i++) {
-        int rand_idx = rand() % num_points;
-        for (size_t j = 0; j < d; j++) {
-            h_centroids[i * d + j] = h_coordinates[rand_idx * d + j];
+    if (!centroids->empty()) {
+        for (int i = 0; i < k; i++) {
+            for (size_t j = 0; j < d; j++) {
+                h_centroids[i * d + j] = centroids->at(i).coordinates[j];
+            }
+        }
+    }
+    else {
+        std::srand(100);
+        for (int i = 0; i < k; i++) {
+            int rand_idx = rand() % num_points;
+            for (size_t j = 0; j < d; j++) {
+                h_centroids[i * d + j] = h_coordinates[rand_idx * d + j];
+            }
         }
     }
+    int firstEpoch = 0;
+    Checkpoint checkpoint;
+    if (checkpointer != NULL) {
+        checkpointer->setShape(num_points, k, d);
+    }
+    const bool resumed = checkpointer != NULL && checkpointer->resume(&checkpoint);
+    if (resumed) {
+        firstEpoch = checkpoint.epoch;
+        std::copy(checkpoint.centroids.begin(), checkpoint.centroids.end(), h_centroids);
+        std::copy(checkpoint.clusters.begin(), checkpoint.clusters.end(), h_clusters);
+        std::copy(checkpoint.minDistances.begin(), checkpoint.minDistances.end(), h_minDistances);
+    }
     float *d_coordinates, *d_centroids, *d_minDistances, *d_sums;
-    int *d_clusters, *d_counts, *d_changed;
+    int *d_clusters, *d_previousClusters, *d_counts, *d_changed;
 
     cudaMalloc(&d_coordinates, num_points * d * sizeof(float));
     cudaMalloc(&d_centroids, k * d * sizeof(float));
     cudaMalloc(&d_clusters, num_points * sizeof(int));
+    cudaMalloc(&d_previousClusters, num_points * sizeof(int));
     cudaMalloc(&d_minDistances, num_points * sizeof(float));
     cudaMalloc(&d_counts, k * sizeof(int));
     cudaMalloc(&d_sums, k * d * sizeof(float));
@@ -111,11 +166,19 @@ void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSi
     cudaMemcpy(d_centroids, h_centroids, k * d * sizeof(float), cudaMemcpyHostToDevice);
     cudaMemcpy(d_clusters, h_clusters, num_points * sizeof(int), cudaMemcpyHostToDevice);
     cudaMemcpy(d_minDistances, h_minDistances, num_points * sizeof(float), cudaMemcpyHostToDevice);
+    if (resumed) {
+        // the running sums and the clusters they were computed with
+        std::vector<float> sums(checkpoint.sums.begin(), checkpoint.sums.end());
+        std::vector<int> counts(checkpoint.counts.begin(), checkpoint.counts.end());
+        cudaMemcpy(d_sums, sums.data(), k * d * sizeof(float), cudaMemcpyHostToDevice);
+        cudaMemcpy(d_counts, counts.data(), k * sizeof(int), cudaMemcpyHostToDevice);
+        cudaMemcpy(d_previousClusters, d_clusters, num_points * sizeof(int), cudaMemcpyDeviceToDevice);
+    }
 
     // const int blockSize = block_size;
     int gridSize = (num_points + blockSize - 1) / blockSize;
     int h_changed = -1;
-    for (int epoch = 0; epoch < maxEpochs; epoch++) {
+    for (int epoch = firstEpoch; epoch < maxEpochs; epoch++) {
         if (h_changed == 0) {
             std::cout << "This Algorithm ran " << epoch << " times." << std::endl;
             break;
@@ -124,18 +187,49 @@ void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSi
         computeDistances<<<gridSize, blockSize>>>(d_coordinates, d_centroids, d_clusters, d_minDistances, num_points, k, d, d_changed);
         cudaDeviceSynchronize();
         cudaMemcpy(&h_changed, d_changed, sizeof(int), cudaMemcpyDeviceToHost);
-        cudaMemset(d_sums, 0, k * d * sizeof(float));
-        cudaMemset(d_counts, 0, k * sizeof(int));
-
-        computeSums<<<gridSize, blockSize>>>(d_coordinates, d_clusters, d_sums, d_counts, num_points, k, d);
+        // running sums: recomputed from every point periodically to bound drift, else only updated with the moved points
+        if (epoch % GRP_FULL_RECOMPUTE_EPOCHS == 0) {
+            cudaMemset(d_sums, 0, k * d * sizeof(float));
+            cudaMemset(d_counts, 0, k * sizeof(int));
+            computeSums<<<gridSize, blockSize>>>(d_coordinates, d_clusters, d_sums, d_counts, num_points, k, d);
+            cudaMemcpy(d_previousClusters, d_clusters, num_points * sizeof(int), cudaMemcpyDeviceToDevice);
+        }
+        else {
+            computeDeltas<<<gridSize, blockSize>>>(d_coordinates, d_clusters, d_previousClusters, d_sums, d_counts, num_points, k, d);
+        }
         cudaDeviceSynchronize();
         updateCentroids<<<k,d>>>(d_centroids, d_sums, d_counts, k, d);
         cudaDeviceSynchronize();
         cudaMemcpy(h_centroids, d_centroids, k * d * sizeof(float), cudaMemcpyDeviceToHost);
+        // a converged run stops at the top of the next epoch, so there is nothing left to save
+        if (h_changed != 0 && checkpointer != NULL && checkpointer->due(epoch)) {
+            std::vector<float> sums(k * d);
+            std::vector<int> counts(k);
+            cudaMemcpy(sums.data(), d_sums, k * d * sizeof(float), cudaMemcpyDeviceToHost);
+            cudaMemcpy(counts.data(), d_counts, k * sizeof(int), cudaMemcpyDeviceToHost);
+            cudaMemcpy(h_clusters, d_clusters, num_points * sizeof(int), cudaMemcpyDeviceToHost);
+            cudaMemcpy(h_minDistances, d_minDistances, num_points * sizeof(float), cudaMemcpyDeviceToHost);
+            checkpoint.epoch = epoch + 1;
+            checkpoint.centroids.assign(h_centroids, h_centroids + k * d);
+            checkpoint.sums.assign(sums.begin(), sums.end());
+            checkpoint.counts.assign(counts.begin(), counts.end());
+            checkpoint.clusters.assign(h_clusters, h_clusters + num_points);
+            checkpoint.minDistances.assign(h_minDistances, h_minDistances + num_points);
+            checkpointer->save(checkpoint);
+        }
     }
     cudaMemcpy(h_clusters, d_clusters, num_points * sizeof(int), cudaMemcpyDeviceToHost);
+    cudaMemcpy(h_minDistances, d_minDistances, num_points * sizeof(float), cudaMemcpyDeviceToHost);
     for (size_t i = 0; i < num_points; i++){
         points->at(i).cluster = h_clusters[i];
+        points->at(i).minDistance = h_minDistances[i];
+    }
+    cudaMemcpy(h_centroids, d_centroids, k * d * sizeof(float), cudaMemcpyDeviceToHost);
+    centroids->assign(k, Point(std::vector<float>(d)));
+    for (int i = 0; i < k; i++) {
+        for (size_t j = 0; j < d; j++) {
+            centroids->at(i).coordinates[j] = h_centroids[i * d + j];
+        }
     }
 
     delete[] h_coordinates;
@@ -145,8 +239,14 @@ void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSi
     cudaFree(d_coordinates);
     cudaFree(d_centroids);
     cudaFree(d_clusters);
+    cudaFree(d_previousClusters);
     cudaFree(d_minDistances);
     cudaFree(d_counts);
     cudaFree(d_sums);
     cudaFree(d_changed);
 }
+
+bool cudaDeviceAvailable() {
+    int deviceCount = 0;
+    return cudaGetDeviceCount(&deviceCount) == cudaSuccess && deviceCount > 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include "point.hpp"
+#include "checkpoint.hpp"
 
 /* --- kMeansCluster ----
  * Determine the clusters for the given data points
@@ -8,6 +9,14 @@
  *   std::vector<Point>* points // in and out
  *   int maxEpochs // in
  *   int k // in
+ *   int blockSize // in
+ *   std::vector<Point>* centroids // in and out: warm-start centroids, or empty for random seeds; the final centroids
+ *   Checkpointer* checkpointer // in, checkpoints the run as configured and resumes it; NULL for none
  */
-void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSize);
+void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k, int blockSize, std::vector<Point>* centroids, Checkpointer* checkpointer = NULL);
+
+/* --- cudaDeviceAvailable ----
+ * Whether at least one CUDA device can be used.
+ */
+bool cudaDeviceAvailable();
 
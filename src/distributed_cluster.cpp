@@ -9,19 +9,24 @@ https://github.com/robertmartin8/RandomWalks/blob/master/kmeans.cpp
 #include <stdexcept>
 #include <iostream>
 #include <functional>
+#include <algorithm>
 #include <boost/mpi/environment.hpp>
 #include <boost/mpi/communicator.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/mpi/collectives.hpp>
 #include "point.hpp"
 #include "distributed_cluster.hpp"
+#include "kernels.hpp"
+#include "checkpoint.hpp"
 #include <iomanip>
 
 void determineClusters(
     boost::mpi::communicator world,
     std::vector<Point>* points,
     int k,
-    int maxEpochs
+    int maxEpochs,
+    std::vector<Point>* centroids,
+    Checkpointer* checkpointer
 ) {
 	if (world.rank() == 0) {
 		std::cout << "Determining clusters with k = " << k << "..." << std::endl;
@@ -29,7 +34,6 @@ void determineClusters(
 	int numberOfPoints;
 	int numberOfCoordinates;
 	std::vector<Point> localPoints;
-	std::vector<Point> centroids;
 
     if (world.rank() == 0) {
         numberOfPoints = points->size();
@@ -39,14 +43,14 @@ void determineClusters(
 	boost::mpi::broadcast(world, numberOfCoordinates, 0);
 
     // initialize centroids
-    if (world.rank() == 0) {
+    if (world.rank() == 0 && centroids->empty()) {
 		std::srand(100);
 		for (int centroidIdx = 0; centroidIdx < k; centroidIdx++) {
-			centroids.push_back(points->at(rand() % points->size()));
+			centroids->push_back(points->at(rand() % points->size()));
 		}
     }
-    else {
-	centroids.resize(k);
+    else if (world.rank() != 0) {
+	centroids->resize(k);
     }
     //distribute points among the processes
 	std::vector<int> localPointCounts(world.size(), numberOfPoints / world.size());
@@ -63,10 +67,11 @@ void determineClusters(
 	kMeansCluster(
 		world,
 		&localPoints,
-		&centroids,
+		centroids,
 		numberOfCoordinates,
 		maxEpochs,
-		k
+		k,
+		checkpointer
 	);
 
     //gather points from the processes
@@ -92,17 +97,61 @@ void kMeansCluster(
     std::vector<Point>* centroids,
     int numberOfCoordinates,
     int maxEpochs,
-    int k
+    int k,
+    Checkpointer* checkpointer
 ){
 
     bool localChanged, anyChanged;
     std::vector<int> localNumberOfPointsInEachCluster(k, 0);
+    std::vector<int> reducedNumberOfPointsInEachCluster(k, 0);
     std::vector<int> globalNumberOfPointsInEachCluster(k, 0);
-    std::vector<std::vector<double>> localSums(k, std::vector<double>(numberOfCoordinates, 0.0));
-    std::vector<std::vector<double>> globalSums(k, std::vector<double>(numberOfCoordinates, 0.0));
+    // flat [k][numberOfCoordinates] sums
+    std::vector<double> localSums(k * numberOfCoordinates, 0.0);
+    std::vector<double> reducedSums(k * numberOfCoordinates, 0.0);
+    std::vector<double> globalSums(k * numberOfCoordinates, 0.0);
+    // cluster of each local point when the sums were last updated
+    std::vector<int> previousClusters(localPoints->size(), -1);
+
+    int firstEpoch = 0;
+    Checkpoint checkpoint;
+    if (checkpointer != NULL) {
+        checkpointer->setShape(localPoints->size(), k, numberOfCoordinates);
+    }
+    if (checkpointer != NULL && checkpointer->resuming()) {
+        //resume from the newest epoch that every process has a valid checkpoint of
+        std::vector<int> localEpochs = checkpointer->validEpochs();
+        localEpochs.resize(2, -1);
+        std::vector<int> epochs;
+        boost::mpi::all_gather(world, localEpochs.data(), 2, epochs);
+        int resumeEpoch = -1;
+        for (int candidate = 0; candidate < 2 && resumeEpoch < 0; candidate++) {
+            bool everywhere = epochs[candidate] >= 0;
+            for (int rank = 1; rank < world.size() && everywhere; rank++) {
+                everywhere = epochs[2 * rank] == epochs[candidate] || epochs[2 * rank + 1] == epochs[candidate];
+            }
+            if (everywhere) {
+                resumeEpoch = epochs[candidate];
+            }
+        }
+        if (resumeEpoch >= 0) {
+            checkpoint = checkpointer->load(resumeEpoch);
+            firstEpoch = resumeEpoch;
+            restoreLabels(checkpoint, localPoints);
+            previousClusters = checkpoint.clusters;
+            if (world.rank() == 0) {
+                restoreCentroids(checkpoint, centroids);
+                globalSums = checkpoint.sums;
+                globalNumberOfPointsInEachCluster.assign(checkpoint.counts.begin(), checkpoint.counts.end());
+                std::cout << "Resuming from the checkpoint at epoch " << resumeEpoch << "." << std::endl;
+            }
+        }
+        else if (world.rank() == 0) {
+            std::cout << "No checkpoint valid on every process, starting from the first epoch." << std::endl;
+        }
+    }
 
     //limit the number of epochs -- prevents infinite loops.
-    for (int epoch = 0; epoch < maxEpochs; epoch++) {
+    for (int epoch = firstEpoch; epoch < maxEpochs; epoch++) {
         //broadcast updated centroids at start of each epoch.
         boost::mpi::broadcast(world, centroids->data(), k, 0);
 
@@ -133,37 +182,48 @@ void kMeansCluster(
             break;
         }
 
-        // reset globalSums to 0 for all clusters and dimensions
-        if (world.rank() == 0) {
-            for (int clusterId = 0; clusterId < k; clusterId++) {
-                for (int dimension = 0; dimension < numberOfCoordinates; dimension++) {
-                    globalSums[clusterId][dimension] = 0.0;
+        // running sums: every GRP_FULL_RECOMPUTE_EPOCHS epochs each process sums all of its points,
+        // in between only the changes of the points that moved cluster are summed and reduced
+        const bool recompute = epoch % GRP_FULL_RECOMPUTE_EPOCHS == 0;
+        std::fill(localSums.begin(), localSums.end(), 0.0);
+        std::fill(localNumberOfPointsInEachCluster.begin(), localNumberOfPointsInEachCluster.end(), 0);
+        for (size_t i = 0; i < localPoints->size(); i++) {
+            const Point& point = localPoints->at(i);
+            const int clusterId = point.cluster;
+            const int previous = previousClusters[i];
+            previousClusters[i] = clusterId;
+            if (!recompute && clusterId == previous) {
+                continue;
+            }
+            if (!recompute && previous >= 0) {
+                localNumberOfPointsInEachCluster[previous] -= 1;
+                for (int d = 0; d < numberOfCoordinates; d++) {
+                    localSums[previous * numberOfCoordinates + d] -= point.coordinates[d];
                 }
-                globalNumberOfPointsInEachCluster[clusterId] = 0;
             }
-        }
-        // reset localSums to 0 for all clusters and dimensions.
-        for (int clusterId = 0; clusterId < k; clusterId++) {
-            for (int dimension = 0; dimension < numberOfCoordinates; dimension++) {
-                localSums[clusterId][dimension] = 0.0;
+            if (clusterId < 0) {
+                continue;
             }
-            localNumberOfPointsInEachCluster[clusterId] = 0;
-        }
-
-        //Compute means
-        //Compute sum of coordinates per cluster for each dimension
-        for (std::vector<Point>::iterator pointIterator = localPoints->begin(); pointIterator != localPoints->end(); pointIterator++) {
-            int clusterId = pointIterator->cluster;
             localNumberOfPointsInEachCluster[clusterId] += 1;
             for (int d = 0; d < numberOfCoordinates; d++) {
-                localSums[clusterId][d] += pointIterator->coordinates[d];
+                localSums[clusterId * numberOfCoordinates + d] += point.coordinates[d];
             }
         }
 
-        //reduce localSums and localNumberOfPointsInEachCluster
-        boost::mpi::reduce(world, localNumberOfPointsInEachCluster.data(), k, globalNumberOfPointsInEachCluster.data(), std::plus<int>(), 0);
-        for (int clusterId = 0; clusterId < k; clusterId++) {
-            boost::mpi::reduce(world, localSums[clusterId].data(), numberOfCoordinates, globalSums[clusterId].data(), std::plus<float>(), 0);
+        //reduce the local sums (or deltas) and add them to the global sums on the root
+        boost::mpi::reduce(world, localNumberOfPointsInEachCluster.data(), k, reducedNumberOfPointsInEachCluster.data(), std::plus<int>(), 0);
+        boost::mpi::reduce(world, localSums.data(), k * numberOfCoordinates, reducedSums.data(), std::plus<double>(), 0);
+        if (world.rank() == 0) {
+            if (recompute) {
+                std::fill(globalSums.begin(), globalSums.end(), 0.0);
+                std::fill(globalNumberOfPointsInEachCluster.begin(), globalNumberOfPointsInEachCluster.end(), 0);
+            }
+            for (int i = 0; i < k * numberOfCoordinates; i++) {
+                globalSums[i] += reducedSums[i];
+            }
+            for (int clusterId = 0; clusterId < k; clusterId++) {
+                globalNumberOfPointsInEachCluster[clusterId] += reducedNumberOfPointsInEachCluster[clusterId];
+            }
         }
 
         //root computes averages given sums and moves centroids
@@ -172,9 +232,25 @@ void kMeansCluster(
             for (std::vector<Point>::iterator centroidIterator = centroids->begin(); centroidIterator != centroids->end(); centroidIterator++) {
                 int clusterId = centroidIterator - centroids->begin();
                 for (int d = 0; d < numberOfCoordinates; d++) {
-                    centroidIterator->coordinates[d] = globalSums[clusterId][d] / globalNumberOfPointsInEachCluster[clusterId];
+                    centroidIterator->coordinates[d] = globalSums[clusterId * numberOfCoordinates + d] / globalNumberOfPointsInEachCluster[clusterId];
                 }
             }
         }
+
+        //every process writes its own shard; the root's also holds the centroids and global sums
+        bool save = checkpointer != NULL && checkpointer->due(epoch);
+        if (checkpointer != NULL && checkpointer->timed()) {
+            boost::mpi::broadcast(world, save, 0);
+        }
+        if (save) {
+            checkpoint.epoch = epoch + 1;
+            storeLabels(*localPoints, &checkpoint);
+            if (world.rank() == 0) {
+                storeCentroids(*centroids, &checkpoint);
+                checkpoint.sums = globalSums;
+                checkpoint.counts.assign(globalNumberOfPointsInEachCluster.begin(), globalNumberOfPointsInEachCluster.end());
+            }
+            checkpointer->save(checkpoint);
+        }
     }
 }
@@ -1,14 +1,27 @@
 #pragma once
 #include <vector>
 #include "point.hpp"
+#include "checkpoint.hpp"
 #include <boost/mpi/communicator.hpp>
 
 
+/* --- determineClusters ----
+ * Scatter the points from the root process, cluster them, and gather them back to the root.
+ * Args:
+ *   boost::mpi::communicator world // in
+ *   std::vector<Point>* points // in and out, only used on the root process
+ *   int k // in
+ *   int maxEpochs // in
+ *   std::vector<Point>* centroids // in and out (root only): warm-start centroids, or empty for random seeds; the final centroids
+ *   Checkpointer* checkpointer // in, this process's shard of the checkpoints; NULL for none
+ */
 void determineClusters(
   boost::mpi::communicator world,
   std::vector<Point>* points,
   int k,
-  int maxEpochs
+  int maxEpochs,
+  std::vector<Point>* centroids,
+  Checkpointer* checkpointer = NULL
 );
 
 /* --- kMeansCluster ----
@@ -19,6 +32,7 @@ void kMeansCluster(boost::mpi::communicator world,
   std::vector<Point>* centroids,
   int numberOfCoordinates,
   int maxEpochs, 
-  int k
+  int k,
+  Checkpointer* checkpointer = NULL
 );
 
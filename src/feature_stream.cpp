@@ -0,0 +1,309 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include "point.hpp"
+#include "bounded_queue.hpp"
+#include "feature_stream.hpp"
+
+static const char FEATURE_FILE_MAGIC[8] = {'G', 'R', 'P', 'F', 'E', 'A', 'T', '1'};
+static const size_t FEATURE_FILE_HEADER_SIZE = sizeof(FEATURE_FILE_MAGIC) + sizeof(uint64_t) + sizeof(uint32_t);
+
+/* --- parseCell ----
+ * Convert the cell [begin, end) to a float without allocating.
+ */
+static float parseCell(const char* begin, const char* end) {
+    const size_t length = end - begin;
+    if (length == 4 && std::strncmp(begin, "True", 4) == 0) {
+        return 1.0;
+    }
+    if (length == 5 && std::strncmp(begin, "False", 5) == 0) {
+        return 0.0;
+    }
+    char buffer[64];
+    if (length == 0 || length >= sizeof(buffer)) {
+        throw std::invalid_argument("parseFeature: cannot convert cell \"" + std::string(begin, end) + "\"");
+    }
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char* parsedEnd;
+    const float value = std::strtof(buffer, &parsedEnd);
+    if (parsedEnd == buffer) {
+        throw std::invalid_argument("parseFeature: cannot convert cell \"" + std::string(begin, end) + "\"");
+    }
+    return value;
+}
+
+float parseFeature(const std::string& feature) {
+    return parseCell(feature.data(), feature.data() + feature.size());
+}
+
+/* --- splitHeader ----
+ * Split a CSV header line into column names.
+ */
+static std::vector<std::string> splitHeader(const std::string& line) {
+    std::vector<std::string> columns;
+    std::string column;
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        }
+        else if (c == ',' && !quoted) {
+            columns.push_back(column);
+            column.clear();
+        }
+        else if (c != '\r') {
+            column.push_back(c);
+        }
+    }
+    columns.push_back(column);
+    return columns;
+}
+
+bool isFeatureFile(std::string filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    char magic[sizeof(FEATURE_FILE_MAGIC)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, FEATURE_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+FeatureStream::FeatureStream(std::string filepath, int shard, int shardCount)
+    : in(filepath, std::ios::binary), binary(false), numberOfDimensions(0), nextRow(0), nextBlock(0), position(0), end(0) {
+    if (!in) {
+        throw std::runtime_error("FeatureStream: could not open " + filepath);
+    }
+    if (shard < 0 || shardCount <= 0 || shard >= shardCount) {
+        throw std::invalid_argument("FeatureStream: shard out of range");
+    }
+    binary = isFeatureFile(filepath);
+
+    if (binary) {
+        uint64_t rows;
+        uint32_t dimensions;
+        in.seekg(sizeof(FEATURE_FILE_MAGIC));
+        in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+        in.read(reinterpret_cast<char*>(&dimensions), sizeof(dimensions));
+        if (!in) {
+            throw std::runtime_error("FeatureStream: " + filepath + " has a truncated header");
+        }
+        numberOfDimensions = dimensions;
+        nextRow = rows * shard / shardCount;
+        end = rows * (shard + 1) / shardCount;
+        in.seekg(FEATURE_FILE_HEADER_SIZE + nextRow * numberOfDimensions * sizeof(float));
+        return;
+    }
+
+    // CSV: map the feature columns from the header
+    std::string header;
+    std::getline(in, header);
+    const uint64_t dataStart = header.size() + 1;
+    std::vector<std::string> columns = splitHeader(header);
+    for (const auto& key : FEATURE_KEYS) {
+        int column = -1;
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (columns[i] == key) {
+                column = i;
+            }
+        }
+        if (column < 0) {
+            throw std::runtime_error("FeatureStream: " + filepath + " has no column " + key);
+        }
+        featureColumns.push_back(column);
+    }
+    numberOfDimensions = featureColumns.size();
+
+    // a line belongs to the shard its first byte falls in
+    in.seekg(0, std::ios::end);
+    const uint64_t fileSize = in.tellg();
+    const uint64_t dataSize = fileSize > dataStart ? fileSize - dataStart : 0;
+    position = dataStart + dataSize * shard / shardCount;
+    end = dataStart + dataSize * (shard + 1) / shardCount;
+    if (shard > 0 && position < end) {
+        in.seekg(position - 1);
+        std::string partial;
+        std::getline(in, partial); // skip the rest of a line owned by the previous shard
+        position += partial.size();
+    }
+    else {
+        in.seekg(position);
+    }
+    in.clear();
+}
+
+bool FeatureStream::read(size_t maxRows, RowBlock* block) {
+    block->index = nextBlock;
+    block->firstRow = nextRow;
+    block->rows = 0;
+    if (binary) {
+        const size_t rows = std::min<uint64_t>(maxRows, end - nextRow);
+        block->features.resize(rows * numberOfDimensions);
+        in.read(reinterpret_cast<char*>(block->features.data()), rows * numberOfDimensions * sizeof(float));
+        if (!in) {
+            throw std::runtime_error("FeatureStream: binary feature file is truncated");
+        }
+        block->rows = rows;
+    }
+    else {
+        block->lines.resize(maxRows);
+        while (block->rows < maxRows && position < end && std::getline(in, block->lines[block->rows])) {
+            position += block->lines[block->rows].size() + 1;
+            if (!block->lines[block->rows].empty()) {
+                block->rows++;
+            }
+        }
+        block->lines.resize(block->rows);
+    }
+    nextRow += block->rows;
+    if (block->rows == 0) {
+        return false;
+    }
+    nextBlock++;
+    return true;
+}
+
+size_t FeatureStream::remainingRows() {
+    if (binary) {
+        return end - nextRow;
+    }
+    //count the non-empty lines starting before the end of the shard, like read()
+    std::vector<char> buffer(1 << 20);
+    size_t rows = 0;
+    uint64_t offset = position;
+    uint64_t lineStart = position;
+    in.clear();
+    in.seekg(position);
+    while (lineStart < end) {
+        in.read(buffer.data(), buffer.size());
+        const size_t count = in.gcount();
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count && lineStart < end; i++) {
+            if (buffer[i] == '\n') {
+                if (offset + i > lineStart) {
+                    rows++;
+                }
+                lineStart = offset + i + 1;
+            }
+        }
+        offset += count;
+    }
+    if (lineStart < end && offset > lineStart) {
+        rows++; // last line has no line break
+    }
+    in.clear();
+    in.seekg(position);
+    return rows;
+}
+
+void FeatureStream::parse(RowBlock* block) const {
+    if (binary) {
+        return;
+    }
+    int lastColumn = 0;
+    for (int column : featureColumns) {
+        lastColumn = std::max(lastColumn, column);
+    }
+    std::vector<int> columnFeature(lastColumn + 1, -1);
+    for (size_t feature = 0; feature < featureColumns.size(); feature++) {
+        columnFeature[featureColumns[feature]] = feature;
+    }
+
+    block->features.resize(block->rows * numberOfDimensions);
+    // exceptions cannot leave an OpenMP region, so remember the first bad row and throw afterwards
+    long long badRow = -1;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long row = 0; row < static_cast<long long>(block->rows); row++) {
+        const std::string& line = block->lines[row];
+        float* features = &block->features[row * numberOfDimensions];
+        const char* cell = line.data();
+        const char* lineEnd = line.data() + line.size();
+        if (lineEnd > cell && *(lineEnd - 1) == '\r') {
+            lineEnd--;
+        }
+        int column = 0;
+        int found = 0;
+        bool quoted = false;
+        for (const char* c = cell; c <= lineEnd && column <= lastColumn; c++) {
+            if (c < lineEnd && *c == '"') {
+                quoted = !quoted;
+                continue;
+            }
+            if (c < lineEnd && (*c != ',' || quoted)) {
+                continue;
+            }
+            if (columnFeature[column] >= 0) {
+                try {
+                    features[columnFeature[column]] = parseCell(cell, c);
+                    found++;
+                }
+                catch (const std::invalid_argument&) {
+                    break;
+                }
+            }
+            column++;
+            cell = c + 1;
+        }
+        if (found != numberOfDimensions) {
+            #ifdef _OPENMP
+            #pragma omp critical
+            #endif
+            if (badRow < 0 || row < badRow) {
+                badRow = row;
+            }
+        }
+    }
+    if (badRow >= 0) {
+        throw std::runtime_error("FeatureStream: row " + std::to_string(block->firstRow + badRow) + " has missing or malformed feature columns");
+    }
+}
+
+BlockReader::BlockReader(FeatureStream* stream, size_t blockRows, size_t depth) : blocks(depth) {
+    reader = std::thread([this, stream, blockRows] {
+        try {
+            RowBlock block;
+            while (stream->read(blockRows, &block)) {
+                if (!blocks.push(std::move(block))) {
+                    break;
+                }
+                block = RowBlock();
+            }
+        }
+        catch (...) {
+            readerError = std::current_exception();
+        }
+        blocks.close();
+    });
+}
+
+void BlockReader::finish() {
+    blocks.close();
+    if (reader.joinable()) {
+        reader.join();
+    }
+}
+
+void writeFeatureFile(std::string filepath, const std::vector<Point>& points) {
+    std::ofstream out(filepath, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("writeFeatureFile: could not open " + filepath);
+    }
+    const uint64_t rows = points.size();
+    const uint32_t dimensions = points.empty() ? 0 : points[0].coordinates.size();
+    out.write(FEATURE_FILE_MAGIC, sizeof(FEATURE_FILE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    out.write(reinterpret_cast<const char*>(&dimensions), sizeof(dimensions));
+    for (const auto& point : points) {
+        out.write(reinterpret_cast<const char*>(point.coordinates.data()), dimensions * sizeof(float));
+    }
+    if (!out) {
+        throw std::runtime_error("writeFeatureFile: failed writing " + filepath);
+    }
+}
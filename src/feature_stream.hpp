@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <exception>
+#include <stdint.h>
+#include "point.hpp"
+#include "bounded_queue.hpp"
+
+// for now, ignoring id,name,album,album_id,artists,artist_ids,track_number,disc_number,explicit,duration_ms,year,release_date
+const std::vector<std::string> FEATURE_KEYS = {
+  "explicit",
+  "danceability",
+  "energy",
+  "key",
+  "loudness",
+  "mode",
+  "speechiness",
+  "acousticness",
+  "instrumentalness",
+  "liveness",
+  "valence",
+  "tempo",
+  "time_signature",
+};
+
+/* --- parseFeature ----
+ * Convert a CSV cell to a float. Expecting cells to look like integers, floats, or boolean "True"/"False".
+ */
+float parseFeature(const std::string& feature);
+
+/* --- RowBlock ----
+ * A block of consecutive rows read from a FeatureStream.
+ *   index // position of the block among the blocks read from its stream
+ *   lines // raw CSV lines, empty for binary feature files
+ *   features // row-major features [rows][dimensions], filled by FeatureStream::parse
+ */
+struct RowBlock {
+  size_t index = 0;
+  size_t firstRow = 0;
+  size_t rows = 0;
+  std::vector<std::string> lines;
+  std::vector<float> features;
+};
+
+/* --- FeatureStream ----
+ * Streams the feature columns of a CSV or binary feature file in blocks of rows, without loading the
+ * whole table. The file can be split into `shardCount` contiguous shards (e.g. one per MPI process);
+ * the stream then only returns the rows of shard `shard`. CSV shards are split by bytes at line
+ * boundaries, binary shards by rows.
+ *
+ * Binary feature file format (native endianness):
+ *   8 byte magic "GRPFEAT1", uint64 rows, uint32 dimensions, then rows * dimensions floats.
+ *
+ * read() only does I/O and parse() only does CPU work, so the two can run on different threads.
+ */
+class FeatureStream {
+  public:
+  FeatureStream(std::string filepath, int shard = 0, int shardCount = 1);
+
+  bool isBinary() const { return binary; }
+  int dimensions() const { return numberOfDimensions; }
+
+  /* Read up to maxRows rows into block. Returns false once the shard is exhausted. */
+  bool read(size_t maxRows, RowBlock* block);
+
+  /* Convert the raw lines of a block to features. Parallel when built with OpenMP. */
+  void parse(RowBlock* block) const;
+
+  /* Number of rows read() has yet to return. Free for binary feature files; CSV shards are scanned
+   * once for line breaks (no parsing) and the stream is left where it was. */
+  size_t remainingRows();
+
+  private:
+  std::ifstream in;
+  bool binary;
+  int numberOfDimensions;
+  std::vector<int> featureColumns; // CSV column of each feature
+  size_t nextRow;
+  size_t nextBlock;
+  uint64_t position; // CSV: byte offset of the next line
+  uint64_t end; // CSV: first byte offset not in this shard; binary: first row not in this shard
+};
+
+// blocks in flight between two pipeline stages
+const size_t PIPELINE_DEPTH = 2;
+
+/* --- BlockReader ----
+ * Reader stage of a block pipeline: a thread reads blocks of `blockRows` rows from a FeatureStream
+ * into a queue of `depth` blocks, for the later stages to pop while it reads ahead. It stops at the
+ * end of the stream, on an error, or once closed. The stream must outlive the reader, and only
+ * parse() may be called on it while the reader runs.
+ */
+class BlockReader {
+  public:
+  BlockReader(FeatureStream* stream, size_t blockRows, size_t depth = PIPELINE_DEPTH);
+  ~BlockReader() { finish(); }
+
+  /* Next block in stream order; false once the stream is exhausted or the reader is closed. */
+  bool pop(RowBlock* block) { return blocks.pop(block); }
+  /* Stop reading, e.g. when a later stage fails; pop returns false once the queue is drained. */
+  void close() { blocks.close(); }
+  /* Close and wait for the reader thread. */
+  void finish();
+  /* The exception the reader stopped with, if any. Valid after finish. */
+  std::exception_ptr error() const { return readerError; }
+
+  private:
+  BoundedQueue<RowBlock> blocks;
+  std::exception_ptr readerError;
+  std::thread reader;
+};
+
+/* --- isFeatureFile ----
+ * Whether the file at filepath starts with the binary feature file magic.
+ */
+bool isFeatureFile(std::string filepath);
+
+/* --- writeFeatureFile ----
+ * Write the coordinates of the points as a binary feature file.
+ */
+void writeFeatureFile(std::string filepath, const std::vector<Point>& points);
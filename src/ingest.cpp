@@ -0,0 +1,231 @@
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <cmath>
+#include "point.hpp"
+#include "feature_stream.hpp"
+#include "kernels.hpp"
+#include "placement.hpp"
+#include "ingest.hpp"
+
+/* --- FirstEpoch ----
+ * State of the ingest: the points of every block so far, the reservoir of seeds, and the
+ * per-cluster sums of the first epoch for the blocks assigned so far.
+ */
+struct FirstEpoch {
+    int k;
+    int dimensions;
+    size_t seedRows;
+    std::vector<std::vector<Point>> blocks;
+    size_t assignedBlocks = 0;
+
+    std::mt19937_64 random{100}; // for consistency
+    std::vector<float> seeds; // [k][dimensions] once seeded
+    size_t sampledRows = 0;
+    bool seeded = false;
+
+    std::vector<double> sums;
+    std::vector<long long> counts;
+};
+
+/* --- sampleSeeds ----
+ * Reservoir sample (algorithm R) the rows of a block that fall inside the seed window.
+ */
+static void sampleSeeds(FirstEpoch* state, const RowBlock& block) {
+    const int dimensions = state->dimensions;
+    for (size_t row = 0; row < block.rows; row++) {
+        if (state->seedRows > 0 && state->sampledRows >= state->seedRows) {
+            return;
+        }
+        const float* features = &block.features[row * dimensions];
+        long long slot = state->sampledRows;
+        if (state->sampledRows >= static_cast<size_t>(state->k)) {
+            std::uniform_int_distribution<unsigned long long> pick(0, state->sampledRows);
+            slot = pick(state->random);
+        }
+        if (slot < state->k) {
+            std::copy(features, features + dimensions, state->seeds.begin() + slot * dimensions);
+        }
+        state->sampledRows++;
+    }
+}
+
+/* --- finishSeeding ----
+ * Fix the seeds. With fewer sampled rows than k, the sampled rows are repeated, like random seeding
+ * would pick the same point more than once.
+ */
+static void finishSeeding(FirstEpoch* state) {
+    const int dimensions = state->dimensions;
+    for (size_t slot = state->sampledRows; slot < static_cast<size_t>(state->k); slot++) {
+        const size_t source = slot % state->sampledRows;
+        std::copy(state->seeds.begin() + source * dimensions, state->seeds.begin() + (source + 1) * dimensions,
+                  state->seeds.begin() + slot * dimensions);
+    }
+    state->seeded = true;
+}
+
+/* --- toPoints ----
+ * Convert a parsed block to points, in parallel, and release its features.
+ */
+static std::vector<Point> toPoints(RowBlock* block, int dimensions) {
+    std::vector<Point> points(block->rows);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long row = 0; row < static_cast<long long>(block->rows); row++) {
+        const float* features = &block->features[row * dimensions];
+        points[row].coordinates.assign(features, features + dimensions);
+    }
+    std::vector<float>().swap(block->features);
+    return points;
+}
+
+/* --- assignBlock ----
+ * First epoch for one block: move each point to its nearest seed and add it to that cluster's sums.
+ * Runs on the parsing team, with per-thread sums merged once per block.
+ */
+template <int D>
+static void assignBlock(FirstEpoch* state, std::vector<Point>* points) {
+    const int k = state->k;
+    const int dimensions = state->dimensions;
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        std::vector<double> localSums(k * dimensions, 0.0);
+        std::vector<long long> localCounts(k, 0);
+        #ifdef _OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for (long long i = 0; i < static_cast<long long>(points->size()); i++) {
+            Point& point = points->at(i);
+            float minSquaredDistance;
+            const int clusterId = nearestCentroid<D>(point.coordinates.data(), state->seeds.data(), k, dimensions, &minSquaredDistance);
+            point.cluster = clusterId;
+            point.minDistance = std::sqrt(minSquaredDistance);
+            localCounts[clusterId]++;
+            for (int d = 0; d < dimensions; d++) {
+                localSums[clusterId * dimensions + d] += point.coordinates[d];
+            }
+        }
+        #ifdef _OPENMP
+        #pragma omp critical
+        #endif
+        {
+            for (int i = 0; i < k * dimensions; i++) {
+                state->sums[i] += localSums[i];
+            }
+            for (int clusterId = 0; clusterId < k; clusterId++) {
+                state->counts[clusterId] += localCounts[clusterId];
+            }
+        }
+    }
+}
+
+/* --- assignPendingBlocks ----
+ * Assign every block added since the last call, once the seeds are known.
+ */
+static void assignPendingBlocks(FirstEpoch* state) {
+    if (!state->seeded) {
+        return;
+    }
+    for (; state->assignedBlocks < state->blocks.size(); state->assignedBlocks++) {
+        if (state->dimensions == GRP_FEATURE_DIMENSIONS) {
+            assignBlock<GRP_FEATURE_DIMENSIONS>(state, &state->blocks[state->assignedBlocks]);
+        }
+        else {
+            assignBlock<0>(state, &state->blocks[state->assignedBlocks]);
+        }
+    }
+}
+
+/* --- buildPoints ----
+ * Move the points of every block into one point store, first touched with the same static
+ * partitioning as the assignment loops (see firstTouch). The coordinates are moved, not copied,
+ * so they stay where the parsing team allocated them.
+ */
+static std::vector<Point> buildPoints(FirstEpoch* state) {
+    std::vector<size_t> blockStarts;
+    size_t rowCount = 0;
+    for (const std::vector<Point>& block : state->blocks) {
+        blockStarts.push_back(rowCount);
+        rowCount += block.size();
+    }
+    std::vector<Point> points;
+    points.reserve(rowCount);
+    firstTouch(points.data(), rowCount, sizeof(Point));
+    points.resize(rowCount);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(rowCount); i++) {
+        const size_t blockIndex = std::upper_bound(blockStarts.begin(), blockStarts.end(), static_cast<size_t>(i)) - blockStarts.begin() - 1;
+        points[i] = std::move(state->blocks[blockIndex][i - blockStarts[blockIndex]]);
+    }
+    std::vector<std::vector<Point>>().swap(state->blocks);
+    return points;
+}
+
+std::vector<Point> ingestPoints(std::string filepath, int k, size_t blockRows, size_t seedRows, std::vector<Point>* centroids) {
+    if (k <= 0) {
+        throw std::invalid_argument("ingestPoints: k must be positive");
+    }
+    FeatureStream stream(filepath);
+    FirstEpoch state;
+    state.k = k;
+    state.dimensions = stream.dimensions();
+    state.seedRows = seedRows;
+    state.seeds.resize(k * state.dimensions);
+    state.sums.resize(k * state.dimensions, 0.0);
+    state.counts.resize(k, 0);
+
+    BlockReader reader(&stream, blockRows);
+
+    // the calling thread's team parses, samples and assigns each block while the reader reads the next
+    std::exception_ptr error;
+    try {
+        RowBlock block;
+        while (reader.pop(&block)) {
+            stream.parse(&block);
+            std::vector<std::string>().swap(block.lines);
+            if (!state.seeded) {
+                sampleSeeds(&state, block);
+                if (seedRows > 0 && state.sampledRows >= seedRows) {
+                    finishSeeding(&state);
+                }
+            }
+            state.blocks.push_back(toPoints(&block, state.dimensions));
+            assignPendingBlocks(&state);
+            block = RowBlock();
+        }
+        if (!state.seeded && state.sampledRows > 0) {
+            finishSeeding(&state);
+            assignPendingBlocks(&state);
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    reader.finish();
+
+    if (error) std::rethrow_exception(error);
+    if (reader.error()) std::rethrow_exception(reader.error());
+
+    centroids->clear();
+    if (!state.seeded) {
+        return std::vector<Point>();
+    }
+    //Move centroids to the mean coordinate of the points in its cluster (empty clusters keep their seed)
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        std::vector<float> coordinates(state.dimensions);
+        for (int d = 0; d < state.dimensions; d++) {
+            const size_t index = clusterId * state.dimensions + d;
+            coordinates[d] = state.counts[clusterId] > 0 ? state.sums[index] / state.counts[clusterId] : state.seeds[index];
+        }
+        centroids->push_back(Point(coordinates));
+    }
+    return buildPoints(&state);
+}
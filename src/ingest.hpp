@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "point.hpp"
+
+/* --- ingestPoints ----
+ * Read a CSV or binary feature file into points with the first epoch overlapped with parsing.
+ * A reader thread reads blocks of `blockRows` rows while the calling thread (and its OpenMP team)
+ * turns each block into points:
+ *   - the k seeds are reservoir sampled from the first `seedRows` rows (all rows if 0),
+ *   - once the seeds are known, every block is assigned to its nearest seed and added to the
+ *     per-cluster sums, while the reader reads the next block.
+ * This is the first epoch of both algorithms (every point starts unassigned, so it moves to its
+ * nearest centroid), so it counts as epoch 1: refine the returned points and centroids with at most
+ * maxEpochs - 1 more.
+ * Args:
+ *   std::string filepath // in
+ *   int k // in
+ *   size_t blockRows // in
+ *   size_t seedRows // in
+ *   std::vector<Point>* centroids // out, the centroids after the first epoch's update
+ * Return: the points, with their cluster and minDistance from the first epoch.
+ */
+std::vector<Point> ingestPoints(std::string filepath, int k, size_t blockRows, size_t seedRows, std::vector<Point>* centroids);
@@ -0,0 +1,57 @@
+#include <string>
+#include <vector>
+#include "rapidcsv.h"
+#include "point.hpp"
+#include "feature_stream.hpp"
+#include "placement.hpp"
+#include "label_file.hpp"
+#include "io.hpp"
+
+/* --- readInputData ----
+ * Read the feature columns of every row of the CSV into points.
+ */
+std::vector<Point> readInputData(std::string filepath) {
+	rapidcsv::Document doc(filepath);
+
+	size_t row_count = doc.GetRowCount();
+	// place the point store on the NUMA nodes of the threads that will work on it before constructing
+	// the points, and parse with the same static partitioning so each thread allocates its own coordinates
+	std::vector<Point> input_data;
+	input_data.reserve(row_count);
+	firstTouch(input_data.data(), row_count, sizeof(Point));
+	input_data.resize(row_count);
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+	#endif
+	for (int row_idx = 0; row_idx < static_cast<int>(row_count); row_idx++) {
+		//for each row
+		std::vector<std::string> row = doc.GetRow<std::string>(row_idx);
+		std::vector<float> coordinates;
+		coordinates.reserve(FEATURE_KEYS.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (size_t feature_idx = 0; feature_idx < FEATURE_KEYS.size(); feature_idx++) {
+			std::string feature = doc.GetCell<std::string>(FEATURE_KEYS[feature_idx], row_idx);
+			coordinates.push_back(parseFeature(feature));
+		}
+		input_data[row_idx] = Point(coordinates);
+	}
+	return input_data;
+}
+
+/* --- writeClusterData ----
+ * Write the input CSV with an extra "cluster" column holding the cluster of each point.
+ */
+void writeClusterData(std::string inputFilepath, std::string outputFilepath, std::vector<Point>* points) {
+	std::vector<int> clusters(points->size());
+	#ifdef _OPENMP
+	#pragma omp parallel for
+	#endif
+	for (int i = 0; i < static_cast<int>(points->size()); i++) {
+		clusters[i] = points->at(i).cluster;
+	}
+	rapidcsv::Document doc(inputFilepath);
+	doc.InsertColumn<int>(doc.GetColumnCount(), clusters, LABEL_COLUMN);
+	doc.Save(outputFilepath);
+}
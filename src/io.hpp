@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "point.hpp"
+
+/* --- readInputData ----
+ * Read the feature columns (FEATURE_KEYS) of every row of a CSV file.
+ * Args:
+ *   std::string filepath // in
+ * Return: one point per row, with cluster -1.
+ */
+std::vector<Point> readInputData(std::string filepath);
+
+/* --- writeClusterData ----
+ * Copy the input CSV to the output path with an extra "cluster" column.
+ * Args:
+ *   std::string inputFilepath // in
+ *   std::string outputFilepath // in
+ *   std::vector<Point>* points // in, one per row of the input
+ */
+void writeClusterData(std::string inputFilepath, std::string outputFilepath, std::vector<Point>* points);
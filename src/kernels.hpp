@@ -0,0 +1,84 @@
+#pragma once
+#include <float.h>
+
+// Number of features read from the spotify CSV (see FEATURE_KEYS). Kernels are specialised for it.
+#define GRP_FEATURE_DIMENSIONS 13
+
+// Running centroid sums are updated from the points that changed cluster, and recomputed from every
+// point once per this many epochs to bound floating point drift.
+#define GRP_FULL_RECOMPUTE_EPOCHS 16
+
+/* --- squaredDistance ----
+ * Squared euclidian distance between two points of `dimensions` floats.
+ * D is the number of dimensions known at compile time (the loop is fully unrolled),
+ * or 0 to use the runtime `dimensions` argument.
+ */
+template <int D>
+inline float squaredDistance(const float* a, const float* b, int dimensions) {
+  const int numberOfDimensions = D > 0 ? D : dimensions;
+  float sum = 0.0f;
+  for (int d = 0; d < numberOfDimensions; d++) {
+    const float diff = a[d] - b[d];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+/* --- nearestCentroid ----
+ * Index of the centroid closest to the point; ties go to the lowest index.
+ * Args:
+ *   const float* point // in, [dimensions]
+ *   const float* centroids // in, row-major [k][dimensions]
+ *   int k // in
+ *   int dimensions // in, ignored when D > 0
+ *   float* minSquaredDistance // out, squared distance to the chosen centroid
+ */
+template <int D>
+inline int nearestCentroid(const float* point, const float* centroids, int k, int dimensions, float* minSquaredDistance) {
+  const int numberOfDimensions = D > 0 ? D : dimensions;
+  float minDistance = FLT_MAX;
+  int cluster = -1;
+  for (int clusterId = 0; clusterId < k; clusterId++) {
+    const float distance = squaredDistance<D>(point, &centroids[clusterId * numberOfDimensions], numberOfDimensions);
+    if (distance < minDistance) {
+      minDistance = distance;
+      cluster = clusterId;
+    }
+  }
+  *minSquaredDistance = minDistance;
+  return cluster;
+}
+
+/* --- assignNearest ----
+ * Label `rows` row-major points with their nearest centroid. Parallel when built with OpenMP.
+ * Args:
+ *   const float* points // in, [rows][dimensions]
+ *   long long rows // in
+ *   const float* centroids // in, [k][dimensions]
+ *   int k // in
+ *   int dimensions // in, ignored when D > 0
+ *   int* labels // out, [rows]
+ */
+template <int D>
+inline void assignNearest(const float* points, long long rows, const float* centroids, int k, int dimensions, int* labels) {
+  const int numberOfDimensions = D > 0 ? D : dimensions;
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+  #endif
+  for (long long row = 0; row < rows; row++) {
+    float minDistance;
+    labels[row] = nearestCentroid<D>(&points[row * numberOfDimensions], centroids, k, numberOfDimensions, &minDistance);
+  }
+}
+
+/* --- assignNearest ----
+ * Runtime dispatch to the specialisation for the feature dimension, or the generic kernel.
+ */
+inline void assignNearest(const float* points, long long rows, const float* centroids, int k, int dimensions, int* labels) {
+  if (dimensions == GRP_FEATURE_DIMENSIONS) {
+    assignNearest<GRP_FEATURE_DIMENSIONS>(points, rows, centroids, k, dimensions, labels);
+  }
+  else {
+    assignNearest<0>(points, rows, centroids, k, dimensions, labels);
+  }
+}
@@ -0,0 +1,44 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstring>
+#include <stdint.h>
+#include "label_file.hpp"
+
+bool isBinaryLabelPath(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+}
+
+void writeLabelHeader(std::ostream& out, bool binary, uint64_t count) {
+    if (binary) {
+        LabelFileHeader header;
+        std::memcpy(header.magic, LABEL_FILE_MAGIC, sizeof(header.magic));
+        header.count = count;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    else {
+        out << LABEL_COLUMN << '\n';
+    }
+}
+
+void writeLabels(std::ostream& out, bool binary, const std::vector<int>& labels) {
+    if (binary) {
+        out.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(int32_t));
+        return;
+    }
+    std::string text;
+    text.reserve(labels.size() * 3);
+    for (int label : labels) {
+        text.append(std::to_string(label));
+        text.push_back('\n');
+    }
+    out.write(text.data(), text.size());
+}
+
+bool readLabelHeader(const char* data, size_t size, LabelFileHeader* header) {
+    if (size < sizeof(LabelFileHeader) || std::memcmp(data, LABEL_FILE_MAGIC, sizeof(LABEL_FILE_MAGIC)) != 0) {
+        return false;
+    }
+    std::memcpy(header, data, sizeof(LabelFileHeader));
+    return true;
+}
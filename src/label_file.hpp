@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+
+/* --- Label files ----
+ * The labels of a clustering run, one per row in row order, in one of two formats:
+ *   - CSV: a LABEL_COLUMN header line, then one label per line
+ *   - binary (paths ending in ".bin"), native endianness: a LabelFileHeader (8 byte magic "GRPLABL1",
+ *     uint64 count), then count int32 labels
+ * Written by predictLabels, read by loadLabels.
+ */
+const std::string LABEL_COLUMN = "cluster";
+const char LABEL_FILE_MAGIC[8] = {'G', 'R', 'P', 'L', 'A', 'B', 'L', '1'};
+
+struct LabelFileHeader {
+  char magic[8];
+  uint64_t count;
+};
+static_assert(sizeof(LabelFileHeader) == 16, "LabelFileHeader must not be padded");
+
+/* --- isBinaryLabelPath ----
+ * Whether labels written to path use the binary format.
+ */
+bool isBinaryLabelPath(const std::string& path);
+
+/* --- writeLabelHeader ----
+ * Write the header of a label file holding count labels. Writing it again at the start of the
+ * file once the count is known is safe, the header size does not depend on it.
+ */
+void writeLabelHeader(std::ostream& out, bool binary, uint64_t count);
+
+/* --- writeLabels ----
+ * Append labels in the given format.
+ */
+void writeLabels(std::ostream& out, bool binary, const std::vector<int>& labels);
+
+/* --- readLabelHeader ----
+ * Parse the binary label file header at the start of data.
+ * Return: false if data is too short or does not start with LABEL_FILE_MAGIC (e.g. a CSV).
+ */
+bool readLabelHeader(const char* data, size_t size, LabelFileHeader* header);
@@ -1,170 +1,367 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include "rapidcsv.h"
+#include <memory>
+#include <chrono>
+#include <algorithm>
 #include "point.hpp"
-#include <map>
-#ifdef MPI_TARGET
-	#include "distributed_cluster.hpp"
+#include "io.hpp"
+#include "clustering.hpp"
+#include "model.hpp"
+#include "feature_stream.hpp"
+#include "predict.hpp"
+#include "placement.hpp"
+#include "ingest.hpp"
+#include "coreset.hpp"
+#ifdef GRP_HAVE_MPI
   #include <boost/mpi/environment.hpp>
   #include <boost/mpi/communicator.hpp>
-  #include <boost/serialization/vector.hpp>
   #include <boost/mpi/collectives.hpp>
 #endif
-#ifdef OMP_TARGET
-	#include <omp.h>
-	#include "shared_cluster.hpp"
-#endif
-#ifdef SERIAL_TARGET
-	#include "shared_cluster.hpp"
-#endif
-#ifdef CUDA_TARGET
-	#include "cuda_cluster.hpp"
-#endif
 
-std::vector<Point> readInputData(std::string filepath) {
-	rapidcsv::Document doc(filepath);
-
-	// for now, ignoring id,name,album,album_id,artists,artist_ids,track_number,disc_number,explicit,duration_ms,year,release_date
-	const std::vector<std::string> FEATURE_KEYS = {
-		"explicit",
-		"danceability",
-		"energy",
-		"key",
-		"loudness",
-		"mode",
-		"speechiness",
-		"acousticness",
-		"instrumentalness",
-		"liveness",
-		"valence",
-		"tempo",
-		"time_signature",
-	};
-
-
-	size_t row_count = doc.GetRowCount();
-	std::vector<Point> input_data(row_count);
-	#ifdef OMP_TARGET
-	#pragma omp parallel for
+/* --- Options ----
+ * Command line: <binary> [input.csv] [thread_count | block_size] [flags]
+ *   --backend <auto|serial|omp|mpi|cuda> // backend to run on; defaults to the target's backend, or auto
+ *   --algorithm <standard|lloyd> // algorithm variant
+ *   --k <n> // number of clusters
+ *   --epochs <n> // maximum epochs
+ *   --threads <n> // OpenMP threads (same as the second positional argument for the OMP backend)
+ *   --block-size <n> // CUDA block size (same as the second positional argument for the CUDA backend)
+ *   --pin <none|compact|spread> // pin OpenMP threads to cores, filling one NUMA node first or spreading over nodes
+ *   --save-model <path> // write the final model to <path> and the label cache to <path>.labels
+ *   --no-model-sums // save only the centroids, not the per-cluster sums and counts
+ *   --model <path> // warm-start from a saved model (and <path>.labels if present)
+ *   --refine-epochs <n> // maximum epochs to run after a warm start
+ *   --predict <path> // only label the input (CSV or binary feature file) with a saved model, no training
+ *   --output <path> // labels file written by --predict (".bin" for binary labels)
+ *   --block-rows <n> // rows per pipeline block in --predict
+ *   --export-features <path> // only convert the input CSV to a binary feature file
+ *   --checkpoint <path> // write checkpoints of the run to files starting with <path>
+ *   --checkpoint-epochs <n> // checkpoint every n epochs
+ *   --checkpoint-seconds <t> // checkpoint after the first epoch ending t seconds after the last checkpoint
+ *   --resume // continue from the latest valid checkpoint at the --checkpoint path, if any
+ *   --pipelined-ingest // overlap parsing the input with seeding and the first epoch, which counts towards --epochs (see ingestPoints)
+ *   --seed-rows <n> // rows the --pipelined-ingest seeds are sampled from, 0 for all rows
+ *   --coreset <m> // stream the input into a weighted summary of at most m points and cluster that instead (see buildCoreset)
+ *   --coreset-labels // after --coreset, label every input row into --output with the final centroids
+ */
+struct Options {
+	std::vector<std::string> positional;
+	ClusterConfig config;
+	std::string saveModelPath;
+	bool saveModelSums = true;
+	std::string modelPath;
+	int refineEpochs = 10;
+	std::string predictModelPath;
+	std::string outputPath = "data/spotify_labels.csv";
+	size_t blockRows = 65536;
+	std::string exportFeaturesPath;
+	bool pipelinedIngest = false;
+	size_t seedRows = 65536;
+	size_t coresetSize = 0;
+	bool coresetLabels = false;
+};
+
+Options parseOptions(int argc, char *argv[]) {
+	Options options;
+	// each executable defaults to its own backend; genre_reveal_party_auto picks one at runtime
+	#if defined(SERIAL_TARGET)
+	options.config.backend = Backend::Serial;
+	#elif defined(OMP_TARGET)
+	options.config.backend = Backend::OpenMP;
+	#elif defined(MPI_TARGET)
+	options.config.backend = Backend::MPI;
+	#elif defined(CUDA_TARGET)
+	options.config.backend = Backend::CUDA;
 	#endif
-	for (int row_idx = 0; row_idx < static_cast<int>(row_count); row_idx++) {
-		//for each row
-		std::vector<std::string> row = doc.GetRow<std::string>(row_idx);
-		std::vector<float> coordinates;
-		coordinates.reserve(FEATURE_KEYS.size());
-		#ifdef OMP_TARGET
-		#pragma omp parallel for
-		#endif
-		for (size_t feature_idx = 0; feature_idx < FEATURE_KEYS.size(); feature_idx++) {
-			std::string feature = doc.GetCell<std::string>(FEATURE_KEYS[feature_idx], row_idx);
-			//try to convert the feature to a float. Expecting strings to look like integers, floats, or boolean "True"/"False"
-			if (feature == "True") {
-				coordinates.push_back(1.0);
-			}
-			else if (feature == "False") {
-				coordinates.push_back(0.0);
-			}
-			else {
-				coordinates.push_back(std::stof(feature));
-			}
-		}
-		input_data[row_idx] = Point(coordinates);
-	}
-	return input_data;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--backend" && i + 1 < argc) {
+			options.config.backend = parseBackend(argv[++i]);
+		}
+		else if (arg == "--algorithm" && i + 1 < argc) {
+			options.config.algorithm = parseAlgorithm(argv[++i]);
+		}
+		else if (arg == "--k" && i + 1 < argc) {
+			options.config.k = std::stoi(argv[++i]);
+		}
+		else if (arg == "--epochs" && i + 1 < argc) {
+			options.config.maxEpochs = std::stoi(argv[++i]);
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			options.config.threadCount = std::stoi(argv[++i]);
+		}
+		else if (arg == "--block-size" && i + 1 < argc) {
+			options.config.blockSize = std::stoi(argv[++i]);
+		}
+		else if (arg == "--pin" && i + 1 < argc) {
+			options.config.placement = parseThreadPlacement(argv[++i]);
+		}
+		else if (arg == "--save-model" && i + 1 < argc) {
+			options.saveModelPath = argv[++i];
+		}
+		else if (arg == "--no-model-sums") {
+			options.saveModelSums = false;
+		}
+		else if (arg == "--model" && i + 1 < argc) {
+			options.modelPath = argv[++i];
+		}
+		else if (arg == "--refine-epochs" && i + 1 < argc) {
+			options.refineEpochs = std::stoi(argv[++i]);
+		}
+		else if (arg == "--predict" && i + 1 < argc) {
+			options.predictModelPath = argv[++i];
+		}
+		else if (arg == "--output" && i + 1 < argc) {
+			options.outputPath = argv[++i];
+		}
+		else if (arg == "--block-rows" && i + 1 < argc) {
+			options.blockRows = std::stoul(argv[++i]);
+		}
+		else if (arg == "--export-features" && i + 1 < argc) {
+			options.exportFeaturesPath = argv[++i];
+		}
+		else if (arg == "--checkpoint" && i + 1 < argc) {
+			options.config.checkpoint.path = argv[++i];
+		}
+		else if (arg == "--checkpoint-epochs" && i + 1 < argc) {
+			options.config.checkpoint.everyEpochs = std::stoi(argv[++i]);
+		}
+		else if (arg == "--checkpoint-seconds" && i + 1 < argc) {
+			options.config.checkpoint.everySeconds = std::stod(argv[++i]);
+		}
+		else if (arg == "--resume") {
+			options.config.checkpoint.resume = true;
+		}
+		else if (arg == "--pipelined-ingest") {
+			options.pipelinedIngest = true;
+		}
+		else if (arg == "--seed-rows" && i + 1 < argc) {
+			options.seedRows = std::stoul(argv[++i]);
+		}
+		else if (arg == "--coreset" && i + 1 < argc) {
+			options.coresetSize = std::stoul(argv[++i]);
+		}
+		else if (arg == "--coreset-labels") {
+			options.coresetLabels = true;
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			throw std::invalid_argument("unknown or incomplete option " + arg);
+		}
+		else {
+			options.positional.push_back(arg);
+		}
+	}
+	if (options.pipelinedIngest && options.config.maxEpochs < 1) {
+		throw std::invalid_argument("--pipelined-ingest runs the first epoch while reading the input and needs --epochs of at least 1");
+	}
+	return options;
 }
 
-void writeClusterData(std::string inputFilepath, std::string outputFilepath, std::vector<Point>* points) {
-	std::vector<int> clusters(points->size());
-	#ifdef OMP_TARGET
-	#pragma omp parallel for
+/* --- warmStart ----
+ * Load a saved model and label cache, reuse the cached labels of unchanged rows and
+ * assign the new ones. Returns the centroids to start refinement from.
+ */
+std::vector<Point> warmStart(const Options& options, std::vector<Point>* points) {
+	ClusterModel model = loadModel(options.modelPath);
+	LabelCache cache = loadLabelCache(options.modelPath + ".labels");
+	size_t reused = applyLabelCache(points, cache);
+	std::cout << "Warm start from " << options.modelPath << ": reusing labels of " << reused << " of "
+		<< points->size() << " points." << std::endl;
+	return warmStartCentroids(points, model, cache, reused);
+}
+
+/* --- saveTrainedModel ----
+ * Save the model and label cache of a finished run, if requested.
+ */
+void saveTrainedModel(const Options& options, const std::vector<Point>& points, int k) {
+	if (options.saveModelPath.empty()) {
+		return;
+	}
+	std::cout << "Saving model..." << std::endl;
+	saveModel(options.saveModelPath, buildModel(points, k, options.saveModelSums));
+	saveLabelCache(options.saveModelPath + ".labels", points);
+	std::cout << "Done. See " << options.saveModelPath << std::endl;
+}
+
+/* --- secondsSince ----
+ * Wall clock seconds elapsed since start.
+ */
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* --- clusterCoreset ----
+ * Summarise the input in one streaming pass (on every process when distributed), run weighted
+ * k-means on the summary, then optionally label every row with the final centroids.
+ * Memory depends on the summary size and block size, not on the number of rows.
+ */
+void clusterCoreset(const Options& options, ClusteringEngine* engine, std::string input_file) {
+	const bool root = engine->rank() == 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Coreset coreset;
+	#ifdef GRP_HAVE_MPI
+	coreset = engine->isDistributed()
+		? buildCoreset(boost::mpi::communicator(), input_file, options.coresetSize, options.blockRows)
+		: buildCoreset(input_file, options.coresetSize, options.blockRows);
+	#else
+	coreset = buildCoreset(input_file, options.coresetSize, options.blockRows);
 	#endif
-	for (int i = 0; i < static_cast<int>(points->size()); i++) {
-		clusters[i] = points->at(i).cluster;
+	const double summariseSeconds = secondsSince(start);
+
+	ClusterModel model;
+	start = std::chrono::steady_clock::now();
+	if (root) {
+		std::cout << "Summarised " << coreset.rows << " rows as " << coreset.size() << " weighted points (at most "
+			<< options.coresetSize << ")." << std::endl;
+	}
+	std::vector<Point> points = coreset.points();
+	engine->clusterWeighted(&points, coreset.weights, &model.centroids, options.config.k, options.config.maxEpochs);
+	const double clusterSeconds = secondsSince(start);
+	if (root && !options.saveModelPath.empty()) {
+		saveModel(options.saveModelPath, model);
+		std::cout << "Saved the centroids to " << options.saveModelPath << std::endl;
+	}
+
+	double labelSeconds = 0.0;
+	if (options.coresetLabels) {
+		start = std::chrono::steady_clock::now();
+		size_t rows;
+		#ifdef GRP_HAVE_MPI
+		if (engine->isDistributed()) {
+			boost::mpi::communicator world;
+			boost::mpi::broadcast(world, model.centroids, 0);
+			rows = predictLabels(world, model, input_file, options.outputPath, options.blockRows);
+		}
+		else {
+			rows = predictLabels(model, input_file, options.outputPath, options.blockRows);
+		}
+		#else
+		rows = predictLabels(model, input_file, options.outputPath, options.blockRows);
+		#endif
+		labelSeconds = secondsSince(start);
+		if (root) {
+			std::cout << "Labelled " << rows << " points. See " << options.outputPath << std::endl;
+		}
+	}
+	if (root) {
+		std::cout << "Timing: summarise " << summariseSeconds << " s, cluster " << clusterSeconds << " s, label "
+			<< labelSeconds << " s" << std::endl;
 	}
-	rapidcsv::Document doc(inputFilepath);
-	doc.InsertColumn<int>(doc.GetColumnCount(), clusters, "cluster");
-	doc.Save(outputFilepath);
 }
 
 int main(int argc, char *argv[]) {
-  
-	const int k = 5;
-	const int maxEpochs = 200;
+  Options options = parseOptions(argc, argv);
 
-  #ifdef MPI_TARGET
-	boost::mpi::environment env(argc, argv); //MPI_Init
-	boost::mpi::communicator world; //provides .rank() and .size()
+  #ifdef GRP_HAVE_MPI
+	// MPI_Init, only if this run may use MPI
+	std::unique_ptr<boost::mpi::environment> env;
+	if (options.config.backend == Backend::MPI || options.config.backend == Backend::Auto) {
+		env.reset(new boost::mpi::environment(argc, argv));
+	}
   #endif
-  
-	#ifdef OMP_TARGET
-  int thread_count = 5;
-	#endif
-	#ifdef CUDA_TARGET
-	int block_size = 32;
-	#endif
 
   std::string input_file = "data/spotify_short.csv";
   const std::string OUTPUT_FILE = "data/spotify_clusters.csv";
-  if (argc >= 2) {
-    input_file = argv[1];
+  if (options.positional.size() >= 1) {
+    input_file = options.positional[0];
   }
-  if (argc >= 3) {
-		#ifdef OMP_TARGET
-		thread_count = std::stoi(argv[2]);
-		#endif
-		#ifdef CUDA_TARGET
-		 block_size = std::stoi(argv[2]);
-		#endif
+  options.config.backend = selectBackend(options.config.backend);
+  if (options.positional.size() >= 2) {
+		if (options.config.backend == Backend::CUDA) {
+			options.config.blockSize = std::stoi(options.positional[1]);
+		}
+		else {
+			options.config.threadCount = std::stoi(options.positional[1]);
+		}
   }
-	#ifdef OMP_TARGET
-	omp_set_num_threads(thread_count);
-	#endif
+	options.config.checkpoint.input = input_file;
+	std::unique_ptr<ClusteringEngine> engine = makeEngine(options.config);
+	const bool root = engine->rank() == 0;
+	if (root) {
+		std::cout << "Using the " << backendName(engine->backend()) << " backend." << std::endl;
+	}
+
+	if (!options.predictModelPath.empty()) {
+		ClusterModel model = loadModel(options.predictModelPath);
+		size_t rows;
+		#ifdef GRP_HAVE_MPI
+		rows = engine->isDistributed()
+			? predictLabels(boost::mpi::communicator(), model, input_file, options.outputPath, options.blockRows)
+			: predictLabels(model, input_file, options.outputPath, options.blockRows);
+		#else
+		rows = predictLabels(model, input_file, options.outputPath, options.blockRows);
+		#endif
+		if (root) {
+			std::cout << "Labelled " << rows << " points. See " << options.outputPath << std::endl;
+		}
+		return 0;
+	}
+
+	if (options.coresetSize > 0) {
+		if (!options.modelPath.empty() || options.pipelinedIngest || !options.exportFeaturesPath.empty()) {
+			throw std::invalid_argument("--coreset cannot be combined with --model, --pipelined-ingest or --export-features");
+		}
+		clusterCoreset(options, engine.get(), input_file);
+		return 0;
+	}
+
 	std::vector<Point> points;
+	std::vector<Point> centroids;
+	int maxEpochs = options.config.maxEpochs;
+	const bool warm = !options.modelPath.empty();
+	if (warm) {
+		maxEpochs = options.refineEpochs;
+	}
+	if (options.pipelinedIngest && (warm || !options.exportFeaturesPath.empty())) {
+		throw std::invalid_argument("--pipelined-ingest cannot be combined with --model or --export-features");
+	}
 
-  #ifdef MPI_TARGET
-	if (world.rank() == 0) {
+	// distributed engines only read the input on the root process
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double readSeconds = 0.0;
+	if (root) {
 		std::cout << "Reading input data..." << std::endl;
-		points = readInputData(input_file);
+		if (options.pipelinedIngest) {
+			points = ingestPoints(input_file, options.config.k, options.blockRows, options.seedRows, &centroids);
+		}
+		else {
+			points = readInputData(input_file);
+		}
+		readSeconds = secondsSince(start);
 		std::cout << "Done. " << points.size() << " points loaded." << std::endl;
+		if (!options.exportFeaturesPath.empty()) {
+			writeFeatureFile(options.exportFeaturesPath, points);
+			std::cout << "Wrote " << options.exportFeaturesPath << std::endl;
+		}
+		else if (warm) {
+			centroids = warmStart(options, &points);
+		}
+	}
+	if (!options.exportFeaturesPath.empty()) {
+		return 0;
 	}
-  #endif
-  #ifndef MPI_TARGET
-  std::cout << "Reading input data..." << std::endl;
-  points = readInputData(input_file);
-  std::cout << "Done. " << points.size() << " points loaded." << std::endl;
-  #endif
-  
-  #ifdef MPI_TARGET
-	determineClusters(world, &points, k, maxEpochs);
-  #endif
-
-  #ifdef OMP_TARGET
-  kMeansCluster(&points, maxEpochs, k);
-  #endif
-
-	#ifdef SERIAL_TARGET
-  kMeansCluster(&points, maxEpochs, k);
-  #endif
 
-	#ifdef CUDA_TARGET
-	kMeansCluster(&points, maxEpochs, k, block_size);
-	#endif
+	if (options.pipelinedIngest) {
+		// the first epoch already ran while the input was parsed, and counts as epoch 1 (parseOptions requires at least 1)
+		maxEpochs--;
+	}
+	start = std::chrono::steady_clock::now();
+	engine->cluster(&points, &centroids, options.config.k, maxEpochs);
+	const double clusterSeconds = secondsSince(start);
 
-  #ifdef MPI_TARGET
-	if (world.rank() == 0) {
+	if (root) {
+		saveTrainedModel(options, points, centroids.size());
 		//write output to csv
 		std::cout << "Writing output csv..." << std::endl;
+		start = std::chrono::steady_clock::now();
 		writeClusterData(input_file, OUTPUT_FILE, &points);
+		const double writeSeconds = secondsSince(start);
 		std::cout << "Done. See " << OUTPUT_FILE << std::endl;
+		std::cout << "Timing: read " << readSeconds << " s, cluster " << clusterSeconds << " s, write "
+			<< writeSeconds << " s" << std::endl;
+		std::cout << describePlacement(points, options.config.placement) << std::endl;
 	}
-  #endif
-  #ifndef MPI_TARGET
-  //write output to csv
-  std::cout << "Writing output csv..." << std::endl;
-  writeClusterData(input_file, OUTPUT_FILE, &points);
-  std::cout << "Done. See " << OUTPUT_FILE << std::endl;
-  #endif
 
 	return 0;
 
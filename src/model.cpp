@@ -0,0 +1,304 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+#include <float.h>
+#include "point.hpp"
+#include "model.hpp"
+
+static const char LABEL_CACHE_MAGIC[8] = {'G', 'R', 'P', 'L', 'B', 'L', '0', '1'};
+
+ClusterModel buildModel(const std::vector<Point>& points, int k, bool includeSums) {
+    ClusterModel model;
+    if (points.empty() || k <= 0) {
+        return model;
+    }
+    const size_t dimensions = points.at(0).coordinates.size();
+    std::vector<std::vector<double>> sums(k, std::vector<double>(dimensions, 0.0));
+    std::vector<long long> counts(k, 0);
+    for (const auto& point : points) {
+        if (point.cluster < 0 || point.cluster >= k) {
+            throw std::invalid_argument("buildModel: every point must be assigned to a cluster");
+        }
+        counts[point.cluster]++;
+        for (size_t d = 0; d < dimensions; d++) {
+            sums[point.cluster][d] += point.coordinates[d];
+        }
+    }
+    model.centroids.resize(k, Point(std::vector<float>(dimensions, 0.0f)));
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        if (counts[clusterId] == 0) {
+            continue;
+        }
+        for (size_t d = 0; d < dimensions; d++) {
+            model.centroids[clusterId].coordinates[d] = static_cast<float>(sums[clusterId][d] / counts[clusterId]);
+        }
+    }
+    if (includeSums) {
+        model.sums = sums;
+        model.counts = counts;
+    }
+    return model;
+}
+
+/*
+ * Model file format, one record per line:
+ *   k <k>
+ *   dimensions <d>
+ *   centroid <clusterId> <d coordinates>
+ *   count <clusterId> <n>          (optional)
+ *   sum <clusterId> <d sums>       (optional)
+ */
+void saveModel(std::string filepath, const ClusterModel& model) {
+    std::ofstream out(filepath);
+    if (!out) {
+        throw std::runtime_error("saveModel: could not open " + filepath);
+    }
+    const size_t dimensions = model.centroids.empty() ? 0 : model.centroids[0].coordinates.size();
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << "k " << model.centroids.size() << "\n";
+    out << "dimensions " << dimensions << "\n";
+    for (size_t clusterId = 0; clusterId < model.centroids.size(); clusterId++) {
+        out << "centroid " << clusterId;
+        for (float coordinate : model.centroids[clusterId].coordinates) {
+            out << " " << coordinate;
+        }
+        out << "\n";
+    }
+    if (model.hasSums()) {
+        for (size_t clusterId = 0; clusterId < model.centroids.size(); clusterId++) {
+            out << "count " << clusterId << " " << model.counts[clusterId] << "\n";
+            out << "sum " << clusterId;
+            for (double sum : model.sums[clusterId]) {
+                out << " " << sum;
+            }
+            out << "\n";
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("saveModel: failed writing " + filepath);
+    }
+}
+
+ClusterModel loadModel(std::string filepath) {
+    std::ifstream in(filepath);
+    if (!in) {
+        throw std::runtime_error("loadModel: could not open " + filepath);
+    }
+    ClusterModel model;
+    size_t k = 0;
+    size_t dimensions = 0;
+    bool sawSums = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream record(line);
+        std::string key;
+        record >> key;
+        if (key == "k") {
+            record >> k;
+            model.centroids.assign(k, Point());
+            model.sums.assign(k, std::vector<double>());
+            model.counts.assign(k, 0);
+            continue;
+        }
+        if (key == "dimensions") {
+            record >> dimensions;
+            continue;
+        }
+        size_t clusterId;
+        if (!(record >> clusterId) || clusterId >= k) {
+            throw std::runtime_error("loadModel: bad cluster id in " + filepath + ": " + line);
+        }
+        if (key == "centroid") {
+            std::vector<float> coordinates(dimensions);
+            for (size_t d = 0; d < dimensions; d++) {
+                record >> coordinates[d];
+            }
+            model.centroids[clusterId] = Point(coordinates);
+        }
+        else if (key == "count") {
+            record >> model.counts[clusterId];
+            sawSums = true;
+        }
+        else if (key == "sum") {
+            model.sums[clusterId].resize(dimensions);
+            for (size_t d = 0; d < dimensions; d++) {
+                record >> model.sums[clusterId][d];
+            }
+            sawSums = true;
+        }
+        else {
+            throw std::runtime_error("loadModel: unknown record in " + filepath + ": " + line);
+        }
+        if (record.fail()) {
+            throw std::runtime_error("loadModel: malformed record in " + filepath + ": " + line);
+        }
+    }
+    if (k == 0 || dimensions == 0) {
+        throw std::runtime_error("loadModel: " + filepath + " is missing k or dimensions");
+    }
+    for (const auto& centroid : model.centroids) {
+        if (centroid.coordinates.size() != dimensions) {
+            throw std::runtime_error("loadModel: " + filepath + " is missing a centroid");
+        }
+    }
+    if (!sawSums) {
+        model.sums.clear();
+        model.counts.clear();
+    }
+    return model;
+}
+
+uint32_t fingerprint(const Point& point) {
+    uint32_t hash = 2166136261u;
+    for (float coordinate : point.coordinates) {
+        unsigned char bytes[sizeof(float)];
+        std::memcpy(bytes, &coordinate, sizeof(float));
+        for (size_t i = 0; i < sizeof(float); i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+/*
+ * Label cache file format (native endianness):
+ *   8 byte magic, uint64 row count, then the fingerprints (uint32), clusters (int32)
+ *   and minDistances (float) of every row as three consecutive arrays.
+ */
+void saveLabelCache(std::string filepath, const std::vector<Point>& points) {
+    std::ofstream out(filepath, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("saveLabelCache: could not open " + filepath);
+    }
+    const uint64_t rows = points.size();
+    std::vector<uint32_t> fingerprints(rows);
+    std::vector<int32_t> clusters(rows);
+    std::vector<float> minDistances(rows);
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (long long i = 0; i < static_cast<long long>(rows); i++) {
+        fingerprints[i] = fingerprint(points[i]);
+        clusters[i] = points[i].cluster;
+        minDistances[i] = points[i].minDistance;
+    }
+    out.write(LABEL_CACHE_MAGIC, sizeof(LABEL_CACHE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    out.write(reinterpret_cast<const char*>(fingerprints.data()), rows * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(clusters.data()), rows * sizeof(int32_t));
+    out.write(reinterpret_cast<const char*>(minDistances.data()), rows * sizeof(float));
+    if (!out) {
+        throw std::runtime_error("saveLabelCache: failed writing " + filepath);
+    }
+}
+
+LabelCache loadLabelCache(std::string filepath) {
+    LabelCache cache;
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) {
+        return cache;
+    }
+    char magic[sizeof(LABEL_CACHE_MAGIC)];
+    uint64_t rows = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    if (!in || std::memcmp(magic, LABEL_CACHE_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("loadLabelCache: " + filepath + " is not a label cache");
+    }
+    cache.fingerprints.resize(rows);
+    cache.clusters.resize(rows);
+    cache.minDistances.resize(rows);
+    in.read(reinterpret_cast<char*>(cache.fingerprints.data()), rows * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(cache.clusters.data()), rows * sizeof(int32_t));
+    in.read(reinterpret_cast<char*>(cache.minDistances.data()), rows * sizeof(float));
+    if (!in) {
+        throw std::runtime_error("loadLabelCache: " + filepath + " is truncated");
+    }
+    return cache;
+}
+
+size_t applyLabelCache(std::vector<Point>* points, const LabelCache& cache) {
+    size_t reused = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel for reduction(+:reused)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(points->size()); i++) {
+        Point& point = points->at(i);
+        if (static_cast<size_t>(i) < cache.size() && cache.clusters[i] >= 0 && cache.fingerprints[i] == fingerprint(point)) {
+            point.cluster = cache.clusters[i];
+            point.minDistance = cache.minDistances[i];
+            reused++;
+        }
+        else {
+            point.cluster = -1;
+            point.minDistance = FLT_MAX;
+        }
+    }
+    return reused;
+}
+
+std::vector<Point> warmStartCentroids(std::vector<Point>* points, const ClusterModel& model, const LabelCache& cache, size_t reusedRows) {
+    const int k = static_cast<int>(model.centroids.size());
+    for (const auto& point : *points) {
+        if (point.cluster >= k) {
+            throw std::invalid_argument("warmStartCentroids: label cache does not match the model");
+        }
+    }
+
+    //assign new and changed rows to the nearest model centroid
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (long long i = 0; i < static_cast<long long>(points->size()); i++) {
+        Point& point = points->at(i);
+        if (point.cluster >= 0) {
+            continue;
+        }
+        for (int clusterId = 0; clusterId < k; clusterId++) {
+            const float distance = model.centroids[clusterId].distance(point);
+            if (distance < point.minDistance) {
+                point.minDistance = distance;
+                point.cluster = clusterId;
+            }
+        }
+    }
+
+    std::vector<Point> centroids = model.centroids;
+    if (!model.hasSums()) {
+        return centroids;
+    }
+    //the saved sums describe exactly the cached rows only if every cached row was reused
+    long long modelRows = 0;
+    for (long long count : model.counts) {
+        modelRows += count;
+    }
+    if (reusedRows != cache.size() || static_cast<long long>(cache.size()) != modelRows) {
+        return centroids;
+    }
+    std::vector<std::vector<double>> sums = model.sums;
+    std::vector<long long> counts = model.counts;
+    for (size_t i = cache.size(); i < points->size(); i++) {
+        const Point& point = points->at(i);
+        counts[point.cluster]++;
+        for (size_t d = 0; d < point.coordinates.size(); d++) {
+            sums[point.cluster][d] += point.coordinates[d];
+        }
+    }
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        if (counts[clusterId] == 0) {
+            continue;
+        }
+        for (size_t d = 0; d < centroids[clusterId].coordinates.size(); d++) {
+            centroids[clusterId].coordinates[d] = static_cast<float>(sums[clusterId][d] / counts[clusterId]);
+        }
+    }
+    return centroids;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "point.hpp"
+
+/* --- ClusterModel ----
+ * The result of a clustering run that can be saved and used to warm-start a later run.
+ *   centroids // final centroid positions, one per cluster
+ *   sums // per-cluster coordinate sums [k][dimensions]; empty if the model was saved without them
+ *   counts // number of points in each cluster; empty if the model was saved without them
+ */
+struct ClusterModel {
+  std::vector<Point> centroids;
+  std::vector<std::vector<double>> sums;
+  std::vector<long long> counts;
+
+  bool hasSums() const { return !sums.empty() && sums.size() == centroids.size() && counts.size() == centroids.size(); }
+};
+
+/* --- LabelCache ----
+ * Labels and distance bounds of every row from a previous run, in row order.
+ * The fingerprint of a row's coordinates is used to detect rows that have changed since.
+ */
+struct LabelCache {
+  std::vector<uint32_t> fingerprints;
+  std::vector<int> clusters;
+  std::vector<float> minDistances;
+
+  size_t size() const { return clusters.size(); }
+};
+
+/* --- buildModel ----
+ * Build a model from clustered points. Centroids are the mean of the points in each cluster.
+ * Args:
+ *   const std::vector<Point>& points // in, every point must have a cluster in [0, k)
+ *   int k // in
+ *   bool includeSums // in, keep the per-cluster sums and counts in the model
+ */
+ClusterModel buildModel(const std::vector<Point>& points, int k, bool includeSums);
+
+/* --- saveModel / loadModel ----
+ * Read and write a model as a small text file. Throws std::runtime_error on I/O or format errors.
+ */
+void saveModel(std::string filepath, const ClusterModel& model);
+ClusterModel loadModel(std::string filepath);
+
+/* --- saveLabelCache / loadLabelCache ----
+ * Read and write the cluster, minDistance and coordinate fingerprint of each point as a binary file.
+ * loadLabelCache returns an empty cache if the file does not exist.
+ */
+void saveLabelCache(std::string filepath, const std::vector<Point>& points);
+LabelCache loadLabelCache(std::string filepath);
+
+/* --- fingerprint ----
+ * FNV-1a hash of the coordinates of a point.
+ */
+uint32_t fingerprint(const Point& point);
+
+/* --- applyLabelCache ----
+ * Restore the cached cluster and minDistance of every row whose coordinates are unchanged.
+ * Rows that are new or changed are reset to cluster -1.
+ * Args:
+ *   std::vector<Point>* points // in and out
+ *   const LabelCache& cache // in
+ * Return: the number of rows that were restored from the cache.
+ */
+size_t applyLabelCache(std::vector<Point>* points, const LabelCache& cache);
+
+/* --- warmStartCentroids ----
+ * Assign every unlabelled point (cluster -1) to the nearest model centroid and compute the
+ * centroids to start refinement from. If the model has sums and counts and the only difference
+ * from the cached run is appended rows, the new rows are folded into the model's sums so the
+ * first refinement epoch already starts from the updated means.
+ * Args:
+ *   std::vector<Point>* points // in and out
+ *   const ClusterModel& model // in
+ *   const LabelCache& cache // in
+ *   size_t reusedRows // in, return value of applyLabelCache
+ * Return: centroids to start refinement epochs from.
+ */
+std::vector<Point> warmStartCentroids(std::vector<Point>* points, const ClusterModel& model, const LabelCache& cache, size_t reusedRows);
@@ -0,0 +1,243 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "point.hpp"
+#include "placement.hpp"
+
+std::string threadPlacementName(ThreadPlacement placement) {
+    switch (placement) {
+        case ThreadPlacement::None: return "none";
+        case ThreadPlacement::Compact: return "compact";
+        case ThreadPlacement::Spread: return "spread";
+    }
+    return "unknown";
+}
+
+ThreadPlacement parseThreadPlacement(std::string name) {
+    for (ThreadPlacement placement : {ThreadPlacement::None, ThreadPlacement::Compact, ThreadPlacement::Spread}) {
+        if (threadPlacementName(placement) == name) {
+            return placement;
+        }
+    }
+    throw std::invalid_argument("unknown thread placement " + name + " (expected none, compact or spread)");
+}
+
+/* --- parseIdList ----
+ * Parse a sysfs cpu or node list such as "0-3,8-11".
+ */
+static std::vector<int> parseIdList(const std::string& list) {
+    std::vector<int> ids;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int id = first; id <= last; id++) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+/* --- NumaNode ----
+ * A NUMA node: its kernel id (ids may have gaps) and its CPUs (none for memory-only nodes).
+ */
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+/* --- numaNodes ----
+ * The online NUMA nodes from sysfs, in id order. A single node 0 with no CPUs listed if unknown.
+ */
+static std::vector<NumaNode> numaNodes() {
+    std::vector<NumaNode> nodes;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string ids;
+    if (online && std::getline(online, ids)) {
+        for (int id : parseIdList(ids)) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string cpus;
+            std::getline(in, cpus);
+            nodes.push_back(NumaNode{id, parseIdList(cpus)});
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, std::vector<int>()});
+    }
+    return nodes;
+}
+
+int numaNodeCount() {
+    int count = 0;
+    for (const NumaNode& node : numaNodes()) {
+        count += node.cpus.empty() ? 0 : 1;
+    }
+    return std::max(count, 1);
+}
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    #ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    #endif
+    return cpus;
+}
+
+void pinThreads(ThreadPlacement placement, int slot) {
+    #if defined(__linux__) && defined(_OPENMP)
+    if (placement == ThreadPlacement::None) {
+        return;
+    }
+    const std::vector<int> allowed = allowedCpus();
+    //allowed CPUs of each node, in node order
+    std::vector<std::vector<int>> nodes;
+    for (const NumaNode& node : numaNodes()) {
+        nodes.push_back(node.cpus);
+    }
+    if (nodes.size() == 1 && nodes[0].empty()) {
+        nodes[0] = allowed;
+    }
+    size_t widestNode = 0;
+    for (auto& cpus : nodes) {
+        std::vector<int> usable;
+        for (int cpu : cpus) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                usable.push_back(cpu);
+            }
+        }
+        cpus = usable;
+        widestNode = std::max(widestNode, cpus.size());
+    }
+    std::vector<int> order;
+    if (placement == ThreadPlacement::Compact) {
+        for (const auto& cpus : nodes) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+    }
+    else {
+        for (size_t i = 0; i < widestNode; i++) {
+            for (const auto& cpus : nodes) {
+                if (i < cpus.size()) {
+                    order.push_back(cpus[i]);
+                }
+            }
+        }
+    }
+    if (order.empty()) {
+        return;
+    }
+    #pragma omp parallel
+    {
+        const size_t position = static_cast<size_t>(slot) * omp_get_num_threads() + omp_get_thread_num();
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(order[position % order.size()], &cpu);
+        sched_setaffinity(0, sizeof(cpu), &cpu);
+    }
+    #else
+    (void)placement;
+    (void)slot;
+    #endif
+}
+
+void firstTouch(void* data, size_t count, size_t elementSize) {
+    volatile char* bytes = static_cast<volatile char*>(data);
+    #ifdef __linux__
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    #else
+    const size_t pageSize = 4096;
+    #endif
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(count); i++) {
+        //touch the first byte of the element and of every page that starts inside it
+        const size_t begin = i * elementSize;
+        const size_t end = begin + elementSize;
+        bytes[begin] = 0;
+        for (size_t page = (begin / pageSize + 1) * pageSize; page < end; page += pageSize) {
+            bytes[page] = 0;
+        }
+    }
+}
+
+/* --- nodesOfPages ----
+ * NUMA node of the page holding each address, or -1 where unknown.
+ */
+static std::vector<int> nodesOfPages(std::vector<void*> addresses) {
+    std::vector<int> nodes(addresses.size(), -1);
+    #if defined(__linux__) && defined(SYS_move_pages)
+    //move_pages with no target nodes only reports where each page is
+    if (!addresses.empty() && syscall(SYS_move_pages, 0, addresses.size(), addresses.data(), NULL, nodes.data(), 0) != 0) {
+        std::fill(nodes.begin(), nodes.end(), -1);
+    }
+    #endif
+    return nodes;
+}
+
+std::string describePlacement(const std::vector<Point>& points, ThreadPlacement placement) {
+    const std::vector<NumaNode> numa = numaNodes();
+    std::ostringstream description;
+    description << "NUMA: " << numaNodeCount() << " node(s), threads pinned " << threadPlacementName(placement);
+    if (points.empty()) {
+        return description.str();
+    }
+
+    const size_t SAMPLES = 4096;
+    const size_t stride = std::max<size_t>(1, points.size() / SAMPLES);
+    std::vector<void*> addresses;
+    for (size_t i = 0; i < points.size(); i += stride) {
+        addresses.push_back(const_cast<Point*>(&points[i]));
+        if (!points[i].coordinates.empty()) {
+            addresses.push_back(const_cast<float*>(points[i].coordinates.data()));
+        }
+    }
+    //pages per node, by position in numa; memory-only nodes can hold pages too
+    std::vector<int> nodes = nodesOfPages(addresses);
+    std::vector<size_t> pagesPerNode(numa.size(), 0);
+    size_t known = 0;
+    for (int node : nodes) {
+        for (size_t i = 0; i < numa.size(); i++) {
+            if (numa[i].id == node) {
+                pagesPerNode[i]++;
+                known++;
+            }
+        }
+    }
+    if (known == 0) {
+        description << ", point store placement unknown";
+        return description.str();
+    }
+    description << ", point store on";
+    description << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < numa.size(); i++) {
+        description << " node" << numa[i].id << " " << 100.0 * pagesPerNode[i] / known << "%";
+    }
+    return description.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "point.hpp"
+
+/* --- ThreadPlacement ----
+ * How OpenMP threads are pinned to cores.
+ *   None // leave placement to the OS (and OMP_PROC_BIND / OMP_PLACES)
+ *   Compact // fill the cores of one NUMA node before moving to the next
+ *   Spread // round-robin the threads over the NUMA nodes
+ */
+enum class ThreadPlacement { None, Compact, Spread };
+
+std::string threadPlacementName(ThreadPlacement placement);
+ThreadPlacement parseThreadPlacement(std::string name);
+
+/* --- numaNodeCount ----
+ * Number of NUMA nodes with CPUs, 1 if unknown.
+ */
+int numaNodeCount();
+
+/* --- allowedCpus ----
+ * CPUs this process is allowed to run on, in increasing order. Empty outside Linux.
+ */
+std::vector<int> allowedCpus();
+
+/* --- pinThreads ----
+ * Pin each thread of the current OpenMP team size to one core, in the given layout, using only
+ * the cores this process is allowed to run on. Processes allowed on the same cores (such as MPI
+ * ranks of one node the launcher did not bind) pass their index among them as `slot`: slot s
+ * starts after the first s * team size cores of the layout, wrapping around when the processes
+ * need more cores than there are. No-op for ThreadPlacement::None or outside Linux.
+ */
+void pinThreads(ThreadPlacement placement, int slot = 0);
+
+/* --- firstTouch ----
+ * Touch the pages of count elements of elementSize bytes with the same static partitioning the
+ * `#pragma omp parallel for schedule(static)` loops over points use, so each page is placed on the
+ * NUMA node of the thread that will work on it. Call on freshly allocated, unconstructed storage.
+ */
+void firstTouch(void* data, size_t count, size_t elementSize);
+
+/* --- describePlacement ----
+ * One line describing the NUMA nodes, the thread placement, and on which nodes a sample of the
+ * point store (Point objects and their coordinates) resides.
+ */
+std::string describePlacement(const std::vector<Point>& points, ThreadPlacement placement);
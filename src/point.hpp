@@ -5,7 +5,7 @@
 #include <float.h>
 #include <limits>
 
-#ifdef MPI_TARGET
+#ifdef GRP_HAVE_MPI
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/serialization.hpp>
@@ -13,7 +13,7 @@
 
 class Point {
   public:
-  #ifdef MPI_TARGET
+  #ifdef GRP_HAVE_MPI
   //https://www.boost.org/doc/libs/1_87_0/doc/html/mpi/tutorial.html#mpi.tutorial.user_data_types
   friend class boost::serialization::access;
 
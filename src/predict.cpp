@@ -0,0 +1,171 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <exception>
+#include <stdint.h>
+#include "model.hpp"
+#include "feature_stream.hpp"
+#include "bounded_queue.hpp"
+#include "kernels.hpp"
+#include "label_file.hpp"
+#include "predict.hpp"
+#ifdef GRP_HAVE_MPI
+#include <boost/mpi/communicator.hpp>
+#include <boost/mpi/collectives.hpp>
+#endif
+
+
+/* --- LabelBlock ----
+ * Labels of a block of rows, passed from the assignment stage to the writer stage.
+ */
+struct LabelBlock {
+    std::vector<int> labels;
+};
+
+/* --- predictStream ----
+ * Run the read -> parse and assign -> write pipeline over one FeatureStream.
+ * The reader and writer each get their own thread; parsing and assignment run on the calling
+ * thread (and its OpenMP team) so they never compete with I/O for the stream.
+ */
+static size_t predictStream(const ClusterModel& model, FeatureStream* stream, std::ostream& out, bool binary, size_t blockRows) {
+    const int k = model.centroids.size();
+    const int dimensions = stream->dimensions();
+    if (dimensions != static_cast<int>(model.centroids.at(0).coordinates.size())) {
+        throw std::invalid_argument("predictLabels: input and model have different dimensions");
+    }
+    std::vector<float> centroids(k * dimensions);
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        for (int d = 0; d < dimensions; d++) {
+            centroids[clusterId * dimensions + d] = model.centroids[clusterId].coordinates[d];
+        }
+    }
+
+    BlockReader reader(stream, blockRows);
+    BoundedQueue<LabelBlock> labelBlocks(PIPELINE_DEPTH);
+    std::exception_ptr writerError;
+
+    std::thread writer([&] {
+        try {
+            LabelBlock block;
+            while (labelBlocks.pop(&block)) {
+                writeLabels(out, binary, block.labels);
+            }
+            if (!out) {
+                throw std::runtime_error("predictLabels: failed writing labels");
+            }
+        }
+        catch (...) {
+            writerError = std::current_exception();
+            labelBlocks.close();
+        }
+    });
+
+    size_t rows = 0;
+    std::exception_ptr error;
+    try {
+        RowBlock block;
+        while (reader.pop(&block)) {
+            stream->parse(&block);
+            LabelBlock labels;
+            labels.labels.resize(block.rows);
+            assignNearest(block.features.data(), block.rows, centroids.data(), k, dimensions, labels.labels.data());
+            rows += block.rows;
+            if (!labelBlocks.push(std::move(labels))) {
+                break;
+            }
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    reader.finish();
+    labelBlocks.close();
+    writer.join();
+
+    if (error) std::rethrow_exception(error);
+    if (reader.error()) std::rethrow_exception(reader.error());
+    if (writerError) std::rethrow_exception(writerError);
+    return rows;
+}
+
+size_t predictLabels(const ClusterModel& model, std::string inputPath, std::string outputPath, size_t blockRows) {
+    FeatureStream stream(inputPath);
+    const bool binary = isBinaryLabelPath(outputPath);
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("predictLabels: could not open " + outputPath);
+    }
+    // the binary header holds the row count, so write a placeholder and patch it at the end
+    writeLabelHeader(out, binary, 0);
+    const uint64_t rows = predictStream(model, &stream, out, binary, blockRows);
+    if (binary) {
+        out.seekp(0);
+        writeLabelHeader(out, binary, rows);
+    }
+    return rows;
+}
+
+#ifdef GRP_HAVE_MPI
+/* --- createLabelFile ----
+ * Root process creates outputPath holding only the header; returns the header size on every process
+ * once the file exists.
+ */
+static size_t createLabelFile(boost::mpi::communicator world, std::string outputPath, bool binary, size_t totalRows) {
+    std::ostringstream header;
+    writeLabelHeader(header, binary, totalRows);
+    if (world.rank() == 0) {
+        std::ofstream out(outputPath, std::ios::binary);
+        out << header.str();
+        if (!out) {
+            throw std::runtime_error("predictLabels: could not write " + outputPath);
+        }
+    }
+    world.barrier();
+    return header.str().size();
+}
+
+size_t predictLabels(boost::mpi::communicator world, const ClusterModel& model, std::string inputPath, std::string outputPath, size_t blockRows) {
+    const bool binary = isBinaryLabelPath(outputPath);
+    FeatureStream stream(inputPath, world.rank(), world.size());
+    size_t totalRows = 0;
+
+    if (binary) {
+        //fixed size labels: the offset only depends on the rows of the shards before, so stream straight into the file
+        const size_t localRows = stream.remainingRows();
+        size_t endRows = 0;
+        boost::mpi::all_reduce(world, localRows, totalRows, std::plus<size_t>());
+        boost::mpi::scan(world, localRows, endRows, std::plus<size_t>());
+        const size_t headerSize = createLabelFile(world, outputPath, binary, totalRows);
+        {
+            std::fstream out(outputPath, std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(headerSize + (endRows - localRows) * sizeof(int32_t));
+            if (predictStream(model, &stream, out, binary, blockRows) != localRows) {
+                throw std::runtime_error("predictLabels: " + inputPath + " changed while labelling");
+            }
+        }
+        world.barrier();
+        return totalRows;
+    }
+
+    //CSV labels have varying lengths: hold this shard's part until its offset in the file is known
+    std::stringstream part;
+    const size_t localRows = predictStream(model, &stream, part, binary, blockRows);
+    const size_t localBytes = part.tellp();
+    size_t endBytes = 0;
+    boost::mpi::all_reduce(world, localRows, totalRows, std::plus<size_t>());
+    boost::mpi::scan(world, localBytes, endBytes, std::plus<size_t>());
+    const size_t headerSize = createLabelFile(world, outputPath, binary, totalRows);
+    if (localBytes > 0) {
+        std::fstream out(outputPath, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(headerSize + endBytes - localBytes);
+        out << part.rdbuf();
+        if (!out) {
+            throw std::runtime_error("predictLabels: could not write " + outputPath);
+        }
+    }
+    world.barrier();
+    return totalRows;
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include "model.hpp"
+#ifdef GRP_HAVE_MPI
+#include <boost/mpi/communicator.hpp>
+#endif
+
+/* --- predictLabels ----
+ * Label every row of a CSV or binary feature file with its nearest model centroid, without training.
+ * Reading, parsing + assignment, and writing run as a three stage pipeline over blocks of `blockRows`
+ * rows, so only a few blocks are in memory at once.
+ * Labels are written in row order as a label file (see label_file.hpp): one per line under a "cluster"
+ * header, or binary if outputPath ends in ".bin".
+ * Args:
+ *   const ClusterModel& model // in
+ *   std::string inputPath // in
+ *   std::string outputPath // in
+ *   size_t blockRows // in
+ * Return: the number of rows labelled.
+ */
+size_t predictLabels(const ClusterModel& model, std::string inputPath, std::string outputPath, size_t blockRows);
+
+#ifdef GRP_HAVE_MPI
+/* --- predictLabels ----
+ * Each process labels its own shard of the input and writes it at its offset in outputPath, after
+ * the header the root process writes. For binary label files the offset follows from the rows of
+ * the shards before (an exclusive scan of FeatureStream::remainingRows, a line count pass for CSV
+ * input), so labels are streamed into the file like the single process version. CSV labels have
+ * varying lengths, so each process keeps its part (about 2 bytes per row) in memory until a scan of
+ * the part sizes gives its offset. Returns the total number of rows labelled (on every process).
+ */
+size_t predictLabels(boost::mpi::communicator world, const ClusterModel& model, std::string inputPath, std::string outputPath, size_t blockRows);
+#endif
@@ -4,12 +4,20 @@ https://github.com/robertmartin8/RandomWalks/blob/master/kmeans.cpp
 */
 
 #include <vector>
+#include <memory>
 #include <float.h>
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#ifdef _OPENMP
 #include <omp.h>
+#endif
 #include "point.hpp"
+#include "kernels.hpp"
+#include "checkpoint.hpp"
+#include "placement.hpp"
+#include "shared_cluster.hpp"
 
 /* --- calcMinimumDistances ----
  * Calculates the minimum distance between the points and the closest centroid.
@@ -27,8 +35,8 @@ bool calcMinimumDistances(std::vector<Point>* points, std::vector<Point>* centro
     for (int centroid_idx = 0; centroid_idx < num_centroids; centroid_idx++) {
         const Point& centroid = centroids->at(centroid_idx);
         const int clusterId = centroid_idx;
-        #ifdef OMP_TARGET
-        #pragma omp parallel for reduction(||:changed)
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) reduction(||:changed)
         #endif
         for (int point_idx = 0; point_idx < static_cast<int>(points->size()); point_idx++) {
             Point& point = points->at(point_idx);
@@ -46,75 +54,364 @@ bool calcMinimumDistances(std::vector<Point>* points, std::vector<Point>* centro
     return changed;
 }
 
+/* --- ClusterSums ----
+ * Running per-cluster coordinate sums and point counts, kept across epochs.
+ *   clusters // the cluster each point was counted in
+ */
+struct ClusterSums {
+    std::vector<std::vector<double>> sums; // [k][dimensions]
+    std::vector<long long> counts;
+    std::vector<int> clusters;
+};
+
+/* --- recomputeSums ----
+ * Compute the sums and counts of every cluster from scratch.
+ */
+static void recomputeSums(const std::vector<Point>& points, int k, ClusterSums* state) {
+    const size_t dimensions = points.at(0).coordinates.size();
+    state->sums.assign(k, std::vector<double>(dimensions, 0.0));
+    state->counts.assign(k, 0);
+    state->clusters.resize(points.size());
+    // This loop is likely unparallelizable using OMP
+    for (size_t i = 0; i < points.size(); i++) {
+        const Point& point = points[i];
+        state->clusters[i] = point.cluster;
+        if (point.cluster < 0) {
+            continue;
+        }
+        state->counts[point.cluster]++;
+        for (size_t d = 0; d < dimensions; d++) {
+            state->sums[point.cluster][d] += point.coordinates[d];
+        }
+    }
+}
+
+/* --- applyDeltas ----
+ * Move the points that changed cluster since the last update from their old cluster's sums to
+ * their new cluster's sums. The arithmetic is proportional to the number of moved points.
+ */
+static void applyDeltas(const std::vector<Point>& points, ClusterSums* state) {
+    const size_t dimensions = points.at(0).coordinates.size();
+    for (size_t i = 0; i < points.size(); i++) {
+        const Point& point = points[i];
+        const int previous = state->clusters[i];
+        if (point.cluster == previous) {
+            continue;
+        }
+        if (previous >= 0) {
+            state->counts[previous]--;
+            for (size_t d = 0; d < dimensions; d++) {
+                state->sums[previous][d] -= point.coordinates[d];
+            }
+        }
+        state->counts[point.cluster]++;
+        for (size_t d = 0; d < dimensions; d++) {
+            state->sums[point.cluster][d] += point.coordinates[d];
+        }
+        state->clusters[i] = point.cluster;
+    }
+}
+
 /* --- moveCentroids ----
  * Based on the cluster each point belongs to, compute the k-means and reposition the centroids.
+ * The running sums are recomputed on the first epoch and every GRP_FULL_RECOMPUTE_EPOCHS epochs,
+ * and only updated with the points that changed cluster in between.
  * Args:
- *   std::vector<Point>* points // in and out (minDistance will change)
+ *   std::vector<Point>* points // in
  *   std::vector<Point>* centroids // in and out
  *   int k // in
+ *   int epoch // in
+ *   ClusterSums* state // in and out
  */
-void moveCentroids(std::vector<Point>* points, std::vector<Point>* centroids, int k) {
-    //Create vectors to keep track of data needed to compute means
-    std::vector<int> numberOfPointsInEachCluster(k, 0);
-    std::vector<std::vector<float>> sums(points->at(0).coordinates.size(), std::vector<float>(k));
-
-    //Compute means
-    //Compute sum of coordinates per cluster for each dimension
-    // This loop is likely unparallelizable using OMP
-    for(const auto& point: *points){
-        int clusterId = point.cluster;
-        numberOfPointsInEachCluster[clusterId]++;
-        for (size_t d = 0; d < sums.size(); d++) {
-            sums[d][clusterId] += point.coordinates[d];
-        }
+void moveCentroids(std::vector<Point>* points, std::vector<Point>* centroids, int k, int epoch, ClusterSums* state) {
+    if (epoch % GRP_FULL_RECOMPUTE_EPOCHS == 0) {
+        recomputeSums(*points, k, state);
+    }
+    else {
+        applyDeltas(*points, state);
     }
     //Move centroids to the mean coordinate of the points in its cluster
-    #ifdef OMP_TARGET
-    #pragma omp parallel for
-    #endif
-    for (size_t clusterId = 0; clusterId < centroids->size(); clusterId++) {
-        #ifdef OMP_TARGET
-        #pragma omp parallel for
-        #endif
-        for (size_t d = 0; d < sums.size(); d++) {
-            centroids->at(clusterId).coordinates[d] = sums[d][clusterId] / numberOfPointsInEachCluster[clusterId];
+    const int dimensions = state->sums.at(0).size();
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        for (int d = 0; d < dimensions; d++) {
+            centroids->at(clusterId).coordinates[d] = state->sums[clusterId][d] / state->counts[clusterId];
         }
     }
 }
 
 /* --- kMeansCluster ----
- * Determine the clusters for the given data points
+ * Refine the given centroids until no point changes cluster or maxEpochs is reached.
+ * Points keep their current cluster and minDistance, so a warm-started run can reuse them.
  * Args:
  *   std::vector<Point>* points // in and out
  *   int maxEpochs // in
- *   int k // in
+ *   std::vector<Point>* centroids // in and out
+ *   Checkpointer* checkpointer // in, may be NULL
  */
-void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k){
+void kMeansCluster(std::vector<Point>* points, int maxEpochs, std::vector<Point>* centroids, Checkpointer* checkpointer){
+    const int k = static_cast<int>(centroids->size());
     //bounds checking
     if (points->empty() || k <= 0 || maxEpochs <= 0) {
         return;
     }
-    //basic information -- reduce number of calls to size functions
-    int numberOfPoints = points->size();
-    //vector of centroids, set capacity to k.
-    std::vector<Point> centroids(k);
-    // randomly select k points to be where the centroids start
-    std::srand(100); // for consistency
-/*This loop cannot be parallelized and remain consistent.*/
-    for (int i=0;i<k;i++) {
-        //set coordinate to that of a random point
-        centroids[i] = (points->at(rand() % numberOfPoints));
+    const size_t dimensions = points->at(0).coordinates.size();
+    ClusterSums sums;
+    int firstEpoch = 0;
+    Checkpoint checkpoint;
+    if (checkpointer != NULL) {
+        checkpointer->setShape(points->size(), k, dimensions);
+    }
+    if (checkpointer != NULL && checkpointer->resume(&checkpoint)) {
+        firstEpoch = checkpoint.epoch;
+        restoreCentroids(checkpoint, centroids);
+        restoreLabels(checkpoint, points);
+        sums.sums.assign(k, std::vector<double>(dimensions));
+        for (int clusterId = 0; clusterId < k; clusterId++) {
+            std::copy(checkpoint.sums.begin() + clusterId * dimensions, checkpoint.sums.begin() + (clusterId + 1) * dimensions, sums.sums[clusterId].begin());
+        }
+        sums.counts = checkpoint.counts;
+        sums.clusters = checkpoint.clusters;
     }
-
     //limit the number of epochs -- prevents infinite loops.
-    for (int epoch = 0; epoch < maxEpochs; epoch++) {
+    for (int epoch = firstEpoch; epoch < maxEpochs; epoch++) {
         // compute the distance from each centroid to each point
         // update the point's cluster as necessary.
-        bool changed = calcMinimumDistances(points, &centroids);
-        moveCentroids(points, &centroids, k);
+        bool changed = calcMinimumDistances(points, centroids);
+        moveCentroids(points, centroids, k, epoch, &sums);
         if(changed == false){
             std::cout << "This algorithm ran " << epoch << " number of times" << std::endl;
             break;
         }
+        if (checkpointer != NULL && checkpointer->due(epoch)) {
+            checkpoint.epoch = epoch + 1;
+            storeCentroids(*centroids, &checkpoint);
+            storeLabels(*points, &checkpoint);
+            checkpoint.sums.clear();
+            for (const auto& clusterSums : sums.sums) {
+                checkpoint.sums.insert(checkpoint.sums.end(), clusterSums.begin(), clusterSums.end());
+            }
+            checkpoint.counts = sums.counts;
+            checkpointer->save(checkpoint);
+        }
+    }
+}
+
+/* --- lloydEpochs ----
+ * Body of lloydCluster for a feature dimension D known at compile time (0: runtime dimension).
+ */
+template <int D>
+static void lloydEpochs(std::vector<Point>* points, int maxEpochs, std::vector<Point>* centroids, Checkpointer* checkpointer) {
+    const long long numberOfPoints = points->size();
+    const int k = centroids->size();
+    const int dimensions = D > 0 ? D : points->at(0).coordinates.size();
+
+    //left uninitialised and first touched with the assignment loop's partitioning, so each thread's
+    //points live on its NUMA node
+    std::unique_ptr<float[]> coordinates(new float[numberOfPoints * dimensions]);
+    std::unique_ptr<int[]> labels(new int[numberOfPoints]);
+    std::unique_ptr<float[]> minDistances(new float[numberOfPoints]);
+    firstTouch(coordinates.get(), numberOfPoints, dimensions * sizeof(float));
+    firstTouch(labels.get(), numberOfPoints, sizeof(int));
+    firstTouch(minDistances.get(), numberOfPoints, sizeof(float));
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < numberOfPoints; i++) {
+        const Point& point = points->at(i);
+        for (int d = 0; d < dimensions; d++) {
+            coordinates[i * dimensions + d] = point.coordinates[d];
+        }
+        labels[i] = point.cluster;
+    }
+    std::vector<float> flatCentroids(k * dimensions);
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        for (int d = 0; d < dimensions; d++) {
+            flatCentroids[clusterId * dimensions + d] = centroids->at(clusterId).coordinates[d];
+        }
+    }
+
+    std::vector<double> sums(k * dimensions, 0.0);
+    std::vector<long long> counts(k, 0);
+    int firstEpoch = 0;
+    Checkpoint checkpoint;
+    if (checkpointer != NULL) {
+        checkpointer->setShape(numberOfPoints, k, dimensions);
+    }
+    if (checkpointer != NULL && checkpointer->resume(&checkpoint)) {
+        firstEpoch = checkpoint.epoch;
+        flatCentroids = checkpoint.centroids;
+        sums = checkpoint.sums;
+        counts = checkpoint.counts;
+        std::copy(checkpoint.clusters.begin(), checkpoint.clusters.end(), labels.get());
+        std::copy(checkpoint.minDistances.begin(), checkpoint.minDistances.end(), minDistances.get());
+    }
+    for (int epoch = firstEpoch; epoch < maxEpochs; epoch++) {
+        long long changed = 0;
+        //running sums: recomputed from every point periodically, else only updated with the moved points
+        const bool recompute = epoch % GRP_FULL_RECOMPUTE_EPOCHS == 0;
+        if (recompute) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            std::fill(counts.begin(), counts.end(), 0);
+        }
+        #ifdef _OPENMP
+        #pragma omp parallel
+        #endif
+        {
+            //per-thread sums (or deltas), merged once per epoch; allocated inside the parallel region so they are
+            //first touched by (and live on the NUMA node of) the thread that uses them
+            std::vector<double> localSums(k * dimensions, 0.0);
+            std::vector<long long> localCounts(k, 0);
+            #ifdef _OPENMP
+            #pragma omp for schedule(static) reduction(+:changed)
+            #endif
+            for (long long i = 0; i < numberOfPoints; i++) {
+                const float* point = &coordinates[i * dimensions];
+                const int clusterId = nearestCentroid<D>(point, flatCentroids.data(), k, dimensions, &minDistances[i]);
+                const int previous = labels[i];
+                if (clusterId != previous) {
+                    labels[i] = clusterId;
+                    changed++;
+                }
+                else if (!recompute) {
+                    continue;
+                }
+                if (!recompute && previous >= 0) {
+                    localCounts[previous]--;
+                    for (int d = 0; d < dimensions; d++) {
+                        localSums[previous * dimensions + d] -= point[d];
+                    }
+                }
+                localCounts[clusterId]++;
+                for (int d = 0; d < dimensions; d++) {
+                    localSums[clusterId * dimensions + d] += point[d];
+                }
+            }
+            #ifdef _OPENMP
+            #pragma omp critical
+            #endif
+            {
+                for (int i = 0; i < k * dimensions; i++) {
+                    sums[i] += localSums[i];
+                }
+                for (int clusterId = 0; clusterId < k; clusterId++) {
+                    counts[clusterId] += localCounts[clusterId];
+                }
+            }
+        }
+        //Move centroids to the mean coordinate of the points in its cluster
+        for (int clusterId = 0; clusterId < k; clusterId++) {
+            if (counts[clusterId] == 0) {
+                continue;
+            }
+            for (int d = 0; d < dimensions; d++) {
+                flatCentroids[clusterId * dimensions + d] = sums[clusterId * dimensions + d] / counts[clusterId];
+            }
+        }
+        if (changed == 0) {
+            std::cout << "This algorithm ran " << epoch << " number of times" << std::endl;
+            break;
+        }
+        if (checkpointer != NULL && checkpointer->due(epoch)) {
+            //minDistances are squared here
+            checkpoint.epoch = epoch + 1;
+            checkpoint.centroids = flatCentroids;
+            checkpoint.sums = sums;
+            checkpoint.counts = counts;
+            checkpoint.clusters.assign(labels.get(), labels.get() + numberOfPoints);
+            checkpoint.minDistances.assign(minDistances.get(), minDistances.get() + numberOfPoints);
+            checkpointer->save(checkpoint);
+        }
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < numberOfPoints; i++) {
+        points->at(i).cluster = labels[i];
+        points->at(i).minDistance = std::sqrt(minDistances[i]);
+    }
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        for (int d = 0; d < dimensions; d++) {
+            centroids->at(clusterId).coordinates[d] = flatCentroids[clusterId * dimensions + d];
+        }
+    }
+}
+
+void lloydCluster(std::vector<Point>* points, int maxEpochs, std::vector<Point>* centroids, Checkpointer* checkpointer) {
+    if (points->empty() || centroids->empty() || maxEpochs <= 0) {
+        return;
+    }
+    if (points->at(0).coordinates.size() == GRP_FEATURE_DIMENSIONS) {
+        lloydEpochs<GRP_FEATURE_DIMENSIONS>(points, maxEpochs, centroids, checkpointer);
+    }
+    else {
+        lloydEpochs<0>(points, maxEpochs, centroids, checkpointer);
+    }
+}
+
+void weightedLloydCluster(std::vector<Point>* points, const std::vector<double>& weights, int maxEpochs, std::vector<Point>* centroids) {
+    if (points->empty() || centroids->empty() || maxEpochs <= 0) {
+        return;
+    }
+    if (weights.size() != points->size()) {
+        throw std::invalid_argument("weightedLloydCluster: every point needs a weight");
+    }
+    const long long numberOfPoints = points->size();
+    const int k = centroids->size();
+    const int dimensions = points->at(0).coordinates.size();
+
+    //first touched with assignNearest's partitioning (see lloydEpochs)
+    std::unique_ptr<float[]> coordinates(new float[numberOfPoints * dimensions]);
+    std::unique_ptr<int[]> labels(new int[numberOfPoints]);
+    std::unique_ptr<int[]> previousLabels(new int[numberOfPoints]);
+    firstTouch(coordinates.get(), numberOfPoints, dimensions * sizeof(float));
+    firstTouch(labels.get(), numberOfPoints, sizeof(int));
+    firstTouch(previousLabels.get(), numberOfPoints, sizeof(int));
+    for (long long i = 0; i < numberOfPoints; i++) {
+        std::copy(points->at(i).coordinates.begin(), points->at(i).coordinates.end(), coordinates.get() + i * dimensions);
+        previousLabels[i] = points->at(i).cluster;
+    }
+    std::vector<float> flatCentroids(k * dimensions);
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        std::copy(centroids->at(clusterId).coordinates.begin(), centroids->at(clusterId).coordinates.end(), flatCentroids.begin() + clusterId * dimensions);
+    }
+
+    std::vector<double> sums(k * dimensions);
+    std::vector<double> totals(k);
+    for (int epoch = 0; epoch < maxEpochs; epoch++) {
+        assignNearest(coordinates.get(), numberOfPoints, flatCentroids.data(), k, dimensions, labels.get());
+        //the summary is small, so the weighted sums are accumulated serially in point order
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(totals.begin(), totals.end(), 0.0);
+        for (long long i = 0; i < numberOfPoints; i++) {
+            totals[labels[i]] += weights[i];
+            for (int d = 0; d < dimensions; d++) {
+                sums[labels[i] * dimensions + d] += weights[i] * coordinates[i * dimensions + d];
+            }
+        }
+        //Move centroids to the weighted mean coordinate of the points in its cluster
+        for (int clusterId = 0; clusterId < k; clusterId++) {
+            if (totals[clusterId] <= 0.0) {
+                continue;
+            }
+            for (int d = 0; d < dimensions; d++) {
+                flatCentroids[clusterId * dimensions + d] = sums[clusterId * dimensions + d] / totals[clusterId];
+            }
+        }
+        if (std::equal(labels.get(), labels.get() + numberOfPoints, previousLabels.get())) {
+            std::cout << "This algorithm ran " << epoch << " number of times" << std::endl;
+            break;
+        }
+        previousLabels.swap(labels);
+    }
+
+    for (long long i = 0; i < numberOfPoints; i++) {
+        const float* point = &coordinates[i * dimensions];
+        float minDistance;
+        points->at(i).cluster = nearestCentroid<0>(point, flatCentroids.data(), k, dimensions, &minDistance);
+        points->at(i).minDistance = std::sqrt(minDistance);
+    }
+    for (int clusterId = 0; clusterId < k; clusterId++) {
+        std::copy(flatCentroids.begin() + clusterId * dimensions, flatCentroids.begin() + (clusterId + 1) * dimensions, centroids->at(clusterId).coordinates.begin());
     }
 }
@@ -1,13 +1,38 @@
 #pragma once
 #include <vector>
 #include "point.hpp"
+#include "checkpoint.hpp"
 
 /* --- kMeansCluster ----
- * Determine the clusters for the given data points
- * Args: 
+ * Refine the given centroids (from seedCentroids, or e.g. loaded from a model).
+ * Points keep their current cluster and minDistance.
+ * Args:
  *   std::vector<Point>* points // in and out
  *   int maxEpochs // in
- *   int k // in
+ *   std::vector<Point>* centroids // in and out
+ *   Checkpointer* checkpointer // in, checkpoints the run as configured and resumes it; NULL for none
  */
-void kMeansCluster(std::vector<Point>* points, int maxEpochs, int k);
+void kMeansCluster(std::vector<Point>* points, int maxEpochs, std::vector<Point>* centroids, Checkpointer* checkpointer = NULL);
 
+/* --- lloydCluster ----
+ * Lloyd's algorithm: every epoch each point moves to its exact nearest centroid, then the centroids
+ * move to the mean of their points. Works on a flat copy of the coordinates with a kernel specialised
+ * for the feature dimension. Points keep their current cluster as the starting assignment.
+ * Args:
+ *   std::vector<Point>* points // in and out
+ *   int maxEpochs // in
+ *   std::vector<Point>* centroids // in and out
+ *   Checkpointer* checkpointer // in, checkpoints the run as configured and resumes it; NULL for none
+ */
+void lloydCluster(std::vector<Point>* points, int maxEpochs, std::vector<Point>* centroids, Checkpointer* checkpointer = NULL);
+
+/* --- weightedLloydCluster ----
+ * Lloyd's algorithm on weighted points (e.g. a coreset): centroids move to the weighted mean of their
+ * points. Meant for small point sets; only the assignment step is parallel.
+ * Args:
+ *   std::vector<Point>* points // in and out
+ *   const std::vector<double>& weights // in, one per point
+ *   int maxEpochs // in
+ *   std::vector<Point>* centroids // in and out
+ */
+void weightedLloydCluster(std::vector<Point>* points, const std::vector<double>& weights, int maxEpochs, std::vector<Point>* centroids);
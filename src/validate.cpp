@@ -0,0 +1,102 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include "validation.hpp"
+
+/* --- Options ----
+ * Command line: genre_reveal_party_validate <expected labels> <actual labels> [flags]
+ * Labels are clustering outputs (CSV with a cluster column, or binary label files); cluster ids may
+ * differ between the two as long as they describe the same partition.
+ *   --features <path> // input the labels belong to (CSV or binary feature file); also compare the cluster centroids
+ *   --max-mismatches <fraction> // largest fraction of rows allowed in a different cluster (default 0)
+ *   --min-ari <x> // smallest adjusted Rand index allowed (default 1)
+ *   --max-centroid-distance <d> // largest distance allowed between matched centroids, with --features (default 1e-4)
+ *   --block-rows <n> // rows per block read from --features
+ */
+struct Options {
+	std::vector<std::string> positional;
+	std::string featuresPath;
+	double maxMismatchFraction = 0.0;
+	double minAdjustedRandIndex = 1.0;
+	double maxCentroidDistance = 1e-4;
+	size_t blockRows = 65536;
+};
+
+Options parseOptions(int argc, char *argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--features" && i + 1 < argc) {
+			options.featuresPath = argv[++i];
+		}
+		else if (arg == "--max-mismatches" && i + 1 < argc) {
+			options.maxMismatchFraction = std::stod(argv[++i]);
+		}
+		else if (arg == "--min-ari" && i + 1 < argc) {
+			options.minAdjustedRandIndex = std::stod(argv[++i]);
+		}
+		else if (arg == "--max-centroid-distance" && i + 1 < argc) {
+			options.maxCentroidDistance = std::stod(argv[++i]);
+		}
+		else if (arg == "--block-rows" && i + 1 < argc) {
+			options.blockRows = std::stoul(argv[++i]);
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			throw std::invalid_argument("unknown or incomplete option " + arg);
+		}
+		else {
+			options.positional.push_back(arg);
+		}
+	}
+	if (options.positional.size() != 2) {
+		throw std::invalid_argument("usage: genre_reveal_party_validate <expected labels> <actual labels> [--features <path>] "
+			"[--max-mismatches <fraction>] [--min-ari <x>] [--max-centroid-distance <d>]");
+	}
+	return options;
+}
+
+/* --- check ----
+ * Print one tolerance check. Return: whether it passed.
+ */
+bool check(std::string name, double value, std::string comparison, double limit, bool passed) {
+	std::cout << (passed ? "PASS " : "FAIL ") << name << " " << value << " (" << comparison << " " << limit << ")" << std::endl;
+	return passed;
+}
+
+int main(int argc, char *argv[]) {
+	Options options = parseOptions(argc, argv);
+	std::cout << std::setprecision(10);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<int> expected = loadLabels(options.positional[0]);
+	std::vector<int> actual = loadLabels(options.positional[1]);
+	LabelComparison comparison = compareLabels(expected, actual);
+
+	std::cout << "Compared " << comparison.rows << " rows: " << comparison.clustersA << " expected and "
+		<< comparison.clustersB << " actual clusters." << std::endl;
+	std::cout << "Cluster matching (expected -> actual):";
+	for (int cluster = 0; cluster < comparison.clustersA; cluster++) {
+		std::cout << " " << cluster << "->" << comparison.matching[cluster];
+	}
+	std::cout << std::endl;
+
+	bool passed = true;
+	const double mismatchFraction = comparison.rows > 0 ? static_cast<double>(comparison.mismatches) / comparison.rows : 0.0;
+	std::cout << "Mismatched rows: " << comparison.mismatches << std::endl;
+	passed &= check("mismatch fraction", mismatchFraction, "<=", options.maxMismatchFraction,
+		mismatchFraction <= options.maxMismatchFraction);
+	passed &= check("adjusted Rand index", comparison.adjustedRandIndex, ">=", options.minAdjustedRandIndex,
+		comparison.adjustedRandIndex >= options.minAdjustedRandIndex);
+	if (!options.featuresPath.empty()) {
+		const double distance = centroidDistance(options.featuresPath, expected, actual, comparison, options.blockRows);
+		passed &= check("max centroid distance", distance, "<=", options.maxCentroidDistance,
+			distance <= options.maxCentroidDistance);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << (passed ? "Labelings match" : "Labelings differ") << " (" << seconds << " s)" << std::endl;
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,520 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "feature_stream.hpp"
+#include "label_file.hpp"
+#include "validation.hpp"
+
+// labelings with more clusters are rejected as malformed: the matching pads the confusion matrix to
+// max(clustersA, clustersB) squared and is O(max^3), under a second at this size
+static const int MAX_CLUSTERS = 512;
+
+/* --- MappedFile ----
+ * A read-only view of a whole file: mmap on POSIX systems, else read into memory.
+ */
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& filepath) : bytes(NULL), length(0) {
+        #if defined(__unix__) || defined(__APPLE__)
+        const int fd = open(filepath.c_str(), O_RDONLY);
+        struct stat status;
+        if (fd < 0 || fstat(fd, &status) != 0) {
+            if (fd >= 0) close(fd);
+            throw std::runtime_error("MappedFile: could not open " + filepath);
+        }
+        length = status.st_size;
+        if (length > 0) {
+            void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED) {
+                throw std::runtime_error("MappedFile: could not map " + filepath);
+            }
+            madvise(mapped, length, MADV_SEQUENTIAL);
+            bytes = static_cast<const char*>(mapped);
+        }
+        else {
+            close(fd);
+        }
+        #else
+        std::ifstream in(filepath, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("MappedFile: could not open " + filepath);
+        }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        bytes = buffer.data();
+        length = buffer.size();
+        #endif
+    }
+
+    ~MappedFile() {
+        #if defined(__unix__) || defined(__APPLE__)
+        if (bytes != NULL) {
+            munmap(const_cast<char*>(bytes), length);
+        }
+        #endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+  private:
+    const char* bytes;
+    size_t length;
+    #if !defined(__unix__) && !defined(__APPLE__)
+    std::vector<char> buffer;
+    #endif
+};
+
+static int threadCount() {
+    #ifdef _OPENMP
+    return omp_get_max_threads();
+    #else
+    return 1;
+    #endif
+}
+
+/* --- clusterColumn ----
+ * Index of the LABEL_COLUMN column in a CSV header line, and whether it is the last column.
+ */
+static int clusterColumn(const char* begin, const char* end, bool* last) {
+    int column = 0;
+    int found = -1;
+    bool quoted = false;
+    std::string name;
+    for (const char* c = begin; c <= end; c++) {
+        if (c < end && *c == '"') {
+            quoted = !quoted;
+        }
+        else if (c == end || (*c == ',' && !quoted)) {
+            if (name == LABEL_COLUMN) {
+                found = column;
+            }
+            name.clear();
+            column++;
+        }
+        else if (*c != '\r') {
+            name.push_back(*c);
+        }
+    }
+    *last = found == column - 1;
+    return found;
+}
+
+/* --- parseLabel ----
+ * Parse the label in the given column of one CSV line (without its newline).
+ * Return: false if the cell is missing or not an integer.
+ */
+static bool parseLabel(const char* begin, const char* end, int column, bool last, int* label) {
+    if (end > begin && *(end - 1) == '\r') {
+        end--;
+    }
+    const char* cell = begin;
+    const char* cellEnd = end;
+    if (last) {
+        // labels never contain commas, so the last column starts after the last comma
+        for (const char* c = end; c > begin; c--) {
+            if (*(c - 1) == ',') {
+                cell = c;
+                break;
+            }
+        }
+        if (cell == begin && column > 0) {
+            return false;
+        }
+    }
+    else {
+        int current = 0;
+        bool quoted = false;
+        cellEnd = NULL;
+        for (const char* c = begin; c <= end; c++) {
+            if (c < end && *c == '"') {
+                quoted = !quoted;
+            }
+            else if (c == end || (*c == ',' && !quoted)) {
+                if (current == column) {
+                    cellEnd = c;
+                    break;
+                }
+                current++;
+                cell = c + 1;
+            }
+        }
+        if (cellEnd == NULL) {
+            return false;
+        }
+    }
+    while (cell < cellEnd && (*cell == ' ' || *cell == '"')) cell++;
+    while (cellEnd > cell && (*(cellEnd - 1) == ' ' || *(cellEnd - 1) == '"')) cellEnd--;
+    bool negative = false;
+    if (cell < cellEnd && *cell == '-') {
+        negative = true;
+        cell++;
+    }
+    if (cell == cellEnd || cellEnd - cell > 9) {
+        return false;
+    }
+    int value = 0;
+    for (const char* c = cell; c < cellEnd; c++) {
+        if (*c < '0' || *c > '9') {
+            return false;
+        }
+        value = value * 10 + (*c - '0');
+    }
+    *label = negative ? -value : value;
+    return true;
+}
+
+/* --- isBlankLine ---- */
+static bool isBlankLine(const char* begin, const char* end) {
+    return end == begin || (end == begin + 1 && *begin == '\r');
+}
+
+static const char* lineEnd(const char* begin, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    return newline != NULL ? newline : end;
+}
+
+/* --- loadCsvLabels ----
+ * Two parallel passes over the same chunks of lines: count the rows of each chunk, then parse each
+ * chunk's labels into its place.
+ */
+static std::vector<int> loadCsvLabels(const MappedFile& file, const std::string& filepath) {
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const char* headerEnd = lineEnd(begin, end);
+    bool last;
+    const int column = clusterColumn(begin, headerEnd, &last);
+    if (column < 0) {
+        throw std::runtime_error("loadLabels: " + filepath + " has no cluster column");
+    }
+    const char* body = headerEnd < end ? headerEnd + 1 : end;
+
+    // chunks start right after a newline, so every line belongs to exactly one chunk
+    const int chunks = threadCount();
+    std::vector<const char*> starts(chunks + 1, end);
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        const char* start = body + (end - body) * chunk / chunks;
+        while (start > body && start < end && *(start - 1) != '\n') start++;
+        starts[chunk] = start;
+    }
+    std::vector<size_t> offsets(chunks + 1, 0);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1)
+    #endif
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        size_t rows = 0;
+        for (const char* line = starts[chunk]; line < starts[chunk + 1];) {
+            const char* next = lineEnd(line, end);
+            if (!isBlankLine(line, next)) rows++;
+            line = next + 1;
+        }
+        offsets[chunk + 1] = rows;
+    }
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        offsets[chunk + 1] += offsets[chunk];
+    }
+
+    std::vector<int> labels(offsets[chunks]);
+    // exceptions cannot leave an OpenMP region, so remember the first bad row and throw afterwards
+    long long badRow = -1;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1)
+    #endif
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        size_t row = offsets[chunk];
+        for (const char* line = starts[chunk]; line < starts[chunk + 1];) {
+            const char* next = lineEnd(line, end);
+            if (!isBlankLine(line, next)) {
+                if (!parseLabel(line, next, column, last, &labels[row])) {
+                    #ifdef _OPENMP
+                    #pragma omp critical
+                    #endif
+                    if (badRow < 0 || static_cast<long long>(row) < badRow) {
+                        badRow = row;
+                    }
+                    break;
+                }
+                row++;
+            }
+            line = next + 1;
+        }
+    }
+    if (badRow >= 0) {
+        throw std::runtime_error("loadLabels: row " + std::to_string(badRow) + " of " + filepath + " has a missing or malformed cluster");
+    }
+    return labels;
+}
+
+static std::vector<int> loadBinaryLabels(const MappedFile& file, const LabelFileHeader& header, const std::string& filepath) {
+    const uint64_t count = header.count;
+    if ((file.size() - sizeof(LabelFileHeader)) / sizeof(int32_t) < count) {
+        throw std::runtime_error("loadLabels: " + filepath + " is truncated");
+    }
+    std::vector<int> labels(count);
+    const char* values = file.data() + sizeof(LabelFileHeader);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (long long i = 0; i < static_cast<long long>(count); i++) {
+        int32_t label;
+        std::memcpy(&label, values + i * sizeof(int32_t), sizeof(label));
+        labels[i] = label;
+    }
+    return labels;
+}
+
+std::vector<int> loadLabels(std::string filepath) {
+    MappedFile file(filepath);
+    if (file.size() == 0) {
+        throw std::runtime_error("loadLabels: " + filepath + " is empty");
+    }
+    LabelFileHeader header;
+    if (readLabelHeader(file.data(), file.size(), &header)) {
+        return loadBinaryLabels(file, header, filepath);
+    }
+    return loadCsvLabels(file, filepath);
+}
+
+/* --- bestMatching ----
+ * Hungarian algorithm on the square cost matrix max - confusion, i.e. the assignment of B clusters
+ * to A clusters that keeps the most rows together. O(n^3) for n = max(clustersA, clustersB).
+ */
+static std::vector<int> bestMatching(const std::vector<long long>& confusion, int clustersA, int clustersB) {
+    const int n = std::max(clustersA, clustersB);
+    long long maxCount = 0;
+    for (long long count : confusion) {
+        maxCount = std::max(maxCount, count);
+    }
+    auto cost = [&](int i, int j) {
+        return (i < clustersA && j < clustersB) ? maxCount - confusion[static_cast<size_t>(i) * clustersB + j] : maxCount;
+    };
+    // potentials u (rows) and v (columns), column -> row assignment p, 1-based with 0 as a sentinel
+    const long long INF = std::numeric_limits<long long>::max() / 4;
+    std::vector<long long> u(n + 1, 0), v(n + 1, 0);
+    std::vector<int> p(n + 1, 0), way(n + 1, 0);
+    for (int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        std::vector<long long> minv(n + 1, INF);
+        std::vector<bool> used(n + 1, false);
+        do {
+            used[j0] = true;
+            const int i0 = p[j0];
+            long long delta = INF;
+            int j1 = 0;
+            for (int j = 1; j <= n; j++) {
+                if (used[j]) continue;
+                const long long current = cost(i0 - 1, j - 1) - u[i0] - v[j];
+                if (current < minv[j]) {
+                    minv[j] = current;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                }
+                else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    std::vector<int> matching(clustersA, -1);
+    for (int j = 1; j <= n; j++) {
+        if (p[j] - 1 < clustersA && j - 1 < clustersB) {
+            matching[p[j] - 1] = j - 1;
+        }
+    }
+    return matching;
+}
+
+static long long pairs(long long count) {
+    return count * (count - 1) / 2;
+}
+
+LabelComparison compareLabels(const std::vector<int>& a, const std::vector<int>& b) {
+    if (a.size() != b.size()) {
+        throw std::invalid_argument("compareLabels: the labelings have " + std::to_string(a.size()) + " and " +
+                                    std::to_string(b.size()) + " rows");
+    }
+    const long long rows = a.size();
+    int maxA = -1;
+    int maxB = -1;
+    int minLabel = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(max:maxA, maxB) reduction(min:minLabel)
+    #endif
+    for (long long i = 0; i < rows; i++) {
+        maxA = std::max(maxA, a[i]);
+        maxB = std::max(maxB, b[i]);
+        minLabel = std::min(minLabel, std::min(a[i], b[i]));
+    }
+    if (minLabel < 0) {
+        throw std::invalid_argument("compareLabels: the labelings contain unassigned (negative) labels");
+    }
+    if (std::max(maxA, maxB) >= MAX_CLUSTERS) {
+        throw std::invalid_argument("compareLabels: cluster ids must be below " + std::to_string(MAX_CLUSTERS));
+    }
+    const size_t cells = static_cast<size_t>(maxA + 1) * static_cast<size_t>(maxB + 1);
+
+    LabelComparison comparison;
+    comparison.rows = rows;
+    comparison.clustersA = maxA + 1;
+    comparison.clustersB = maxB + 1;
+    const int clustersB = comparison.clustersB;
+    comparison.confusion.assign(cells, 0);
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        // per-thread confusion matrices, merged once
+        std::vector<long long> local(comparison.confusion.size(), 0);
+        #ifdef _OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for (long long i = 0; i < rows; i++) {
+            local[static_cast<size_t>(a[i]) * clustersB + b[i]]++;
+        }
+        #ifdef _OPENMP
+        #pragma omp critical
+        #endif
+        for (size_t i = 0; i < local.size(); i++) {
+            comparison.confusion[i] += local[i];
+        }
+    }
+
+    comparison.matching = bestMatching(comparison.confusion, comparison.clustersA, clustersB);
+    long long agreeing = 0;
+    for (int clusterA = 0; clusterA < comparison.clustersA; clusterA++) {
+        if (comparison.matching[clusterA] >= 0) {
+            agreeing += comparison.confusion[static_cast<size_t>(clusterA) * clustersB + comparison.matching[clusterA]];
+        }
+    }
+    comparison.mismatches = rows - agreeing;
+
+    // adjusted Rand index from the pair counts of the confusion matrix, its row and column sums
+    long long pairsTogether = 0;
+    long long pairsA = 0;
+    long long pairsB = 0;
+    std::vector<long long> columnSums(clustersB, 0);
+    for (int clusterA = 0; clusterA < comparison.clustersA; clusterA++) {
+        long long rowSum = 0;
+        for (int clusterB = 0; clusterB < clustersB; clusterB++) {
+            const long long count = comparison.confusion[static_cast<size_t>(clusterA) * clustersB + clusterB];
+            pairsTogether += pairs(count);
+            rowSum += count;
+            columnSums[clusterB] += count;
+        }
+        pairsA += pairs(rowSum);
+    }
+    for (long long columnSum : columnSums) {
+        pairsB += pairs(columnSum);
+    }
+    const double expected = rows > 1 ? static_cast<double>(pairsA) * pairsB / pairs(rows) : 0.0;
+    const double maximum = 0.5 * (static_cast<double>(pairsA) + pairsB);
+    comparison.adjustedRandIndex = maximum == expected ? 1.0 : (pairsTogether - expected) / (maximum - expected);
+    return comparison;
+}
+
+double centroidDistance(std::string featuresPath, const std::vector<int>& a, const std::vector<int>& b,
+                        const LabelComparison& comparison, size_t blockRows) {
+    FeatureStream stream(featuresPath);
+    const int dimensions = stream.dimensions();
+    const int clustersA = comparison.clustersA;
+    const int clustersB = comparison.clustersB;
+    std::vector<double> sumsA(clustersA * dimensions, 0.0);
+    std::vector<double> sumsB(clustersB * dimensions, 0.0);
+    std::vector<long long> countsA(clustersA, 0);
+    std::vector<long long> countsB(clustersB, 0);
+
+    RowBlock block;
+    size_t rows = 0;
+    while (stream.read(blockRows, &block)) {
+        if (block.firstRow + block.rows > a.size()) {
+            throw std::runtime_error("centroidDistance: " + featuresPath + " has more rows than the labels");
+        }
+        stream.parse(&block);
+        #ifdef _OPENMP
+        #pragma omp parallel
+        #endif
+        {
+            std::vector<double> localA(sumsA.size(), 0.0);
+            std::vector<double> localB(sumsB.size(), 0.0);
+            std::vector<long long> localCountsA(clustersA, 0);
+            std::vector<long long> localCountsB(clustersB, 0);
+            #ifdef _OPENMP
+            #pragma omp for schedule(static)
+            #endif
+            for (long long row = 0; row < static_cast<long long>(block.rows); row++) {
+                const float* features = &block.features[row * dimensions];
+                const int clusterA = a[block.firstRow + row];
+                const int clusterB = b[block.firstRow + row];
+                localCountsA[clusterA]++;
+                localCountsB[clusterB]++;
+                for (int d = 0; d < dimensions; d++) {
+                    localA[clusterA * dimensions + d] += features[d];
+                    localB[clusterB * dimensions + d] += features[d];
+                }
+            }
+            #ifdef _OPENMP
+            #pragma omp critical
+            #endif
+            {
+                for (size_t i = 0; i < localA.size(); i++) sumsA[i] += localA[i];
+                for (size_t i = 0; i < localB.size(); i++) sumsB[i] += localB[i];
+                for (int i = 0; i < clustersA; i++) countsA[i] += localCountsA[i];
+                for (int i = 0; i < clustersB; i++) countsB[i] += localCountsB[i];
+            }
+        }
+        rows += block.rows;
+    }
+    if (rows != a.size()) {
+        throw std::runtime_error("centroidDistance: " + featuresPath + " has " + std::to_string(rows) + " rows, the labels " +
+                                 std::to_string(a.size()));
+    }
+
+    double maxDistance = 0.0;
+    for (int clusterA = 0; clusterA < clustersA; clusterA++) {
+        const int clusterB = comparison.matching[clusterA];
+        if (clusterB < 0 || countsA[clusterA] == 0 || countsB[clusterB] == 0) {
+            continue;
+        }
+        double distance = 0.0;
+        for (int d = 0; d < dimensions; d++) {
+            const double diff = sumsA[clusterA * dimensions + d] / countsA[clusterA] - sumsB[clusterB * dimensions + d] / countsB[clusterB];
+            distance += diff * diff;
+        }
+        maxDistance = std::max(maxDistance, std::sqrt(distance));
+    }
+    return maxDistance;
+}
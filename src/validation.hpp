@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/* --- loadLabels ----
+ * Read the labels of a clustering result with mmap. Accepts
+ *   - a CSV with a "cluster" column (the clusters CSV written by a training run, or --predict output)
+ *   - a binary label file (see label_file.hpp)
+ * CSV rows are split between the OpenMP threads at line boundaries and parsed in parallel.
+ * Throws std::runtime_error if the file cannot be read, has no cluster column or a label is malformed.
+ */
+std::vector<int> loadLabels(std::string filepath);
+
+/* --- LabelComparison ----
+ * How well two labelings of the same rows agree, independent of the cluster ids each one picked.
+ *   clustersA, clustersB // number of cluster ids (largest id + 1) in each labeling
+ *   confusion // row-major [clustersA][clustersB]: rows labelled a in A and b in B
+ *   matching // cluster of B matched to each cluster of A (-1 if unmatched), maximising the rows that agree
+ *   mismatches // rows whose B cluster is not the one matched to their A cluster
+ *   adjustedRandIndex // 1 for identical partitions, about 0 for unrelated ones
+ */
+struct LabelComparison {
+  size_t rows = 0;
+  int clustersA = 0;
+  int clustersB = 0;
+  std::vector<long long> confusion;
+  std::vector<int> matching;
+  size_t mismatches = 0;
+  double adjustedRandIndex = 1.0;
+};
+
+/* --- compareLabels ----
+ * Build the confusion matrix of two labelings in parallel, find the best one-to-one cluster id
+ * matching (Hungarian algorithm on the confusion matrix) and compute the mismatches and the
+ * adjusted Rand index. Throws std::invalid_argument if the labelings have different lengths,
+ * contain negative labels, or have more clusters than the matching can handle (ids of 512 and above).
+ */
+LabelComparison compareLabels(const std::vector<int>& a, const std::vector<int>& b);
+
+/* --- centroidDistance ----
+ * Stream the features of the rows (CSV or binary feature file, see FeatureStream), compute the
+ * centroid of every cluster of both labelings, and return the largest euclidian distance between
+ * the centroids of matched clusters that have rows in both labelings.
+ * Throws std::runtime_error if the feature file has a different number of rows.
+ */
+double centroidDistance(std::string featuresPath, const std::vector<int>& a, const std::vector<int>& b,
+                        const LabelComparison& comparison, size_t blockRows);